@@ -1,6 +1,6 @@
 #!/bin/bash
 
-mpirun -n 2 player/main 4 black.txt 
+mpirun --bind-to none -n 2 player/main 4 black.txt --pin compact
 #mpirun -n 4 --oversubscribe ./hello
 
 #run program multiple times too see if a deadlock occurs...
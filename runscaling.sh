@@ -0,0 +1,127 @@
+#!/bin/bash
+#
+# Strong and weak scaling of the parallel search over the bench suite.
+#
+# Strong scaling searches the suite to a fixed depth at every rank count.
+# Weak scaling adds a ply each time the rank count grows by the step
+# factor, so the work per worker stays roughly the same. The one rank run
+# is the serial search and the baseline for both.
+#
+# Usage: ./runscaling.sh [-d depth] [-w weak-depth] [-s step] [-c count]
+#                        [-r "ranks"] [-m "modes"] [-- extra main options]
+#
+#   speedup     serial time / parallel time (weak: serial rate at each
+#               depth's useful nodes, see below)
+#   efficiency  speedup / ranks
+#   overhead    nodes searched beyond the serial search at that depth
+#   comm        share of the time the busiest rank was not searching
+#   imbalance   how much less the average rank searched than the busiest
+#
+# Weak efficiency counts only the nodes the serial search needs at that
+# depth as useful work: (serial nodes / time) / (ranks * base rate).
+# Past the rank count where efficiency drops off, more cores stop paying.
+
+depth=6
+weak_depth=4
+step=4
+count=64
+ranks="1 2 4 8 16"
+modes="split lazy"
+
+while getopts "d:w:s:c:r:m:" opt
+do
+    case $opt in
+        d) depth=$OPTARG ;;
+        w) weak_depth=$OPTARG ;;
+        s) step=$OPTARG ;;
+        c) count=$OPTARG ;;
+        r) ranks=$OPTARG ;;
+        m) modes=$OPTARG ;;
+        *) exit 1 ;;
+    esac
+done
+shift $((OPTIND - 1))
+
+# prints "nodes seconds comm% imbalance%" for one run
+run()
+{
+    mpirun --oversubscribe -n $1 player/main --bench --parallel --depth $2 --count $count \
+        --search $3 "${@:4}" |
+        awk '/^bench:/ { nodes = $(NF - 4); time = $(NF - 2) + 0 }
+             /^busy:/  { comm = $7 + 0; imbalance = $9 + 0 }
+             END       { if (nodes == "") exit 1; print nodes, time, comm, imbalance }'
+}
+
+# extra plies for weak scaling at $1 ranks: one per factor of $step
+extra()
+{
+    local n=$1 plies=0
+    while [ $n -ge $step ]
+    do
+        n=$((n / step))
+        plies=$((plies + 1))
+    done
+    echo $plies
+}
+
+report()
+{
+    awk -v p=$1 -v d=$2 -v n=$3 -v t=$4 -v c=$5 -v i=$6 -v sn=$7 -v st=$8 -v bn=$9 -v bt=${10} '
+        BEGIN {
+            if (bn == "")
+                speedup = t > 0 ? st / t : 0
+            else
+                speedup = t > 0 && bt > 0 ? (sn / t) / (bn / bt) : 0
+            printf "%5d %5d %12d %9.3f %7.2fx %9.1f%% %8.1f%% %6.1f%% %9.1f%%\n",
+                   p, d, n, t, speedup, 100 * speedup / p, (sn > 0 ? 100 * (n / sn - 1) : 0), c, i
+        }'
+}
+
+header()
+{
+    echo "$1"
+    echo "ranks depth        nodes      time speedup efficiency overhead   comm imbalance"
+}
+
+for mode in $modes
+do
+    # serial baselines at every depth either experiment needs
+    declare -A serial
+    for d in $depth $(for p in $ranks; do echo $((weak_depth + $(extra $p))); done | sort -un)
+    do
+        serial[$d]=$(run 1 $d $mode "$@") || exit 1
+    done
+
+    header "strong scaling: $mode search, depth $depth, $count positions"
+    read sn st sc si <<< "${serial[$depth]}"
+    for p in $ranks
+    do
+        if [ $p -eq 1 ]
+        then
+            read n t c i <<< "${serial[$depth]}"
+        else
+            result=$(run $p $depth $mode "$@") || exit 1
+            read n t c i <<< "$result"
+        fi
+        report $p $depth $n $t $c $i $sn $st
+    done
+    echo
+
+    header "weak scaling: $mode search, depth $weak_depth + 1 per ${step}x ranks, $count positions"
+    read bn bt bc bi <<< "${serial[$weak_depth]}"
+    for p in $ranks
+    do
+        d=$((weak_depth + $(extra $p)))
+        read sn st sc si <<< "${serial[$d]}"
+        if [ $p -eq 1 ]
+        then
+            read n t c i <<< "${serial[$d]}"
+        else
+            result=$(run $p $d $mode "$@") || exit 1
+            read n t c i <<< "$result"
+        fi
+        report $p $d $n $t $c $i $sn $st $bn $bt
+    done
+    echo
+    unset serial
+done
@@ -0,0 +1,61 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mpi.h>
+#include "comms.h"
+#include "arena.h"
+
+static char *base;
+static size_t capacity, top;
+
+/**
+ * Function to allocate the arena, called once per rank at startup.
+ *
+ * @param fixed  bytes the buffers need, each rounded up with
+ *               ARENA_ROUND()
+ *
+ * @return SUCCESS or FAILURE
+ */
+int arena_init(size_t fixed)
+{
+    capacity = ARENA_ROUND(fixed);
+    base = aligned_alloc(ARENA_ALIGN, capacity);
+    if (base == NULL)
+        return FAILURE;
+    memset(base, 0, capacity);
+    top = 0;
+    return SUCCESS;
+}
+
+/**
+ * Function to take a buffer from the arena. The memory is not cleared.
+ *
+ * @param bytes
+ *
+ * @return buffer aligned to ARENA_ALIGN
+ */
+void *arena_alloc(size_t bytes)
+{
+    void *p;
+
+    if (top + ARENA_ROUND(bytes) > capacity)
+    {
+        fprintf(stderr, "arena: %zu bytes wanted with %zu of %zu in use\n", bytes, top, capacity);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    p = base + top;
+    top += ARENA_ROUND(bytes);
+    return p;
+}
+
+void arena_free()
+{
+    free(base);
+    base = NULL;
+    capacity = top = 0;
+}
+
+size_t arena_size()
+{
+    return capacity;
+}
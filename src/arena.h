@@ -0,0 +1,24 @@
+#ifndef _ARENA_H
+#define _ARENA_H
+
+#include <stddef.h>
+
+/*
+    Per-rank arena for the search's buffers. One block is allocated at
+    startup and every buffer is cut from it by bumping a top offset,
+    each region starting on its own cache line so no two buffers share
+    one. The buffers (the move lists and the root division arrays)
+    last as long as the rank. The block never grows, so a rank's memory
+    for these buffers is fixed when it starts; running out is a bug and
+    aborts the job. Not for the MCTS threads, only the rank's own thread
+    allocates.
+ */
+#define ARENA_ALIGN 64
+#define ARENA_ROUND(n) (((n) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+
+int arena_init(size_t fixed);
+void *arena_alloc(size_t bytes);
+void arena_free();
+size_t arena_size();
+
+#endif
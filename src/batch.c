@@ -0,0 +1,402 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mpi.h>
+#include "comms.h"
+#include "player.h"
+#include "batch.h"
+#include "evaluate.h"
+#include "bitboard.h"
+
+static int batch_depth = MAX_DEPTH;
+static int batch_binary = 0;
+
+static void batch_master(FILE *in, FILE *out);
+static void batch_worker();
+static int read_chunk(FILE *in, struct batch_position *chunk, long *line);
+static void write_results(FILE *out, struct batch_result *results, int count);
+
+/**
+ * Entry point for batch analysis, called on every rank.
+ *
+ * Usage: main --batch <positions> <results> [--depth n] [--binary]
+ *
+ * @param argc
+ * @param argv
+ *
+ * @return SUCCESS or FAILURE
+ */
+int batch_main(int argc, char *argv[])
+{
+    FILE *in = NULL, *out = NULL;
+
+    for (int i = 4; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--depth") == 0 && i + 1 < argc)
+            batch_depth = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--binary") == 0)
+            batch_binary = 1;
+    }
+    if (batch_depth < 1)
+        batch_depth = 1;
+
+    /* batch searches are independent, there are no bounds to share */
+    share_bounds = 0;
+
+    if (rank != 0)
+    {
+        batch_worker();
+        return SUCCESS;
+    }
+
+    in = fopen(argv[2], batch_binary ? "rb" : "r");
+    out = fopen(argv[3], "w");
+    if (in == NULL || out == NULL)
+    {
+        fprintf(stderr, "batch: cannot open %s\n", in == NULL ? argv[2] : argv[3]);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    batch_master(in, out);
+    fclose(in);
+    fclose(out);
+    return SUCCESS;
+}
+
+/**
+ * Rank 0 reads the input a chunk at a time and deals the chunks out to
+ * whichever worker is free. Finished chunks are held in a reorder window
+ * until every earlier chunk has been written, and no chunk is handed out
+ * past the end of the window, so memory stays bounded by the window no
+ * matter how large the input is.
+ *
+ * @param in
+ * @param out
+ */
+static void batch_master(FILE *in, FILE *out)
+{
+    int workers = size - 1;
+    int window = workers > 0 ? 2 * workers : 1;
+    long line = 0;
+    int eof = 0;
+    int next_read = 0, next_write = 0, outstanding = 0;
+    int n_idle = 0;
+
+    struct batch_position *chunk = malloc(BATCH_CHUNK * sizeof(struct batch_position));
+    struct batch_result *slots = malloc((size_t)window * BATCH_CHUNK * sizeof(struct batch_result));
+    int *slot_counts = malloc(window * sizeof(int));
+    int *idle = malloc((workers + 1) * sizeof(int));
+    size_t work_size = 2 * sizeof(int) + BATCH_CHUNK * sizeof(struct batch_position);
+    size_t result_size = 2 * sizeof(int) + BATCH_CHUNK * sizeof(struct batch_result);
+    char *msg = malloc(work_size > result_size ? work_size : result_size);
+
+    for (int i = 0; i < window; i++)
+        slot_counts[i] = -1;
+
+    /* no workers: rank 0 analyses every chunk itself */
+    if (workers == 0)
+    {
+        int count;
+        while ((count = read_chunk(in, chunk, &line)) > 0)
+        {
+            for (int i = 0; i < count; i++)
+                batch_analyse(&chunk[i], batch_depth, &slots[i]);
+            write_results(out, slots, count);
+        }
+        free(chunk);
+        free(slots);
+        free(slot_counts);
+        free(idle);
+        free(msg);
+        return;
+    }
+
+    for (int i = 1; i < size; i++)
+        idle[n_idle++] = i;
+
+    while (1)
+    {
+        /* hand out work while the reorder window has room */
+        while (n_idle > 0 && !eof && next_read < next_write + window)
+        {
+            int count = read_chunk(in, chunk, &line);
+            if (count == 0)
+            {
+                eof = 1;
+                break;
+            }
+            int header[2] = {next_read, count};
+            memcpy(msg, header, sizeof(header));
+            memcpy(msg + sizeof(header), chunk, count * sizeof(struct batch_position));
+            MPI_Send(msg, sizeof(header) + count * sizeof(struct batch_position), MPI_BYTE,
+                     idle[--n_idle], BATCH_WORK, MPI_COMM_WORLD);
+            next_read++;
+            outstanding++;
+        }
+        if (outstanding == 0)
+            break;
+
+        MPI_Status status;
+        int header[2];
+        MPI_Recv(msg, result_size, MPI_BYTE,
+                 MPI_ANY_SOURCE, BATCH_RESULT, MPI_COMM_WORLD, &status);
+        memcpy(header, msg, sizeof(header));
+        int slot = header[0] % window;
+        memcpy(&slots[slot * BATCH_CHUNK], msg + sizeof(header), header[1] * sizeof(struct batch_result));
+        slot_counts[slot] = header[1];
+        idle[n_idle++] = status.MPI_SOURCE;
+        outstanding--;
+
+        /* write every chunk that is now in order */
+        while (slot_counts[next_write % window] >= 0)
+        {
+            slot = next_write % window;
+            write_results(out, &slots[slot * BATCH_CHUNK], slot_counts[slot]);
+            slot_counts[slot] = -1;
+            next_write++;
+        }
+    }
+
+    for (int i = 1; i < size; i++)
+        MPI_Send(NULL, 0, MPI_BYTE, i, BATCH_STOP, MPI_COMM_WORLD);
+
+    free(chunk);
+    free(slots);
+    free(slot_counts);
+    free(idle);
+    free(msg);
+}
+
+/**
+ * Worker ranks analyse chunks until rank 0 sends BATCH_STOP.
+ */
+static void batch_worker()
+{
+    int header[2];
+    MPI_Status status;
+    size_t work_size = sizeof(header) + BATCH_CHUNK * sizeof(struct batch_position);
+    size_t result_size = sizeof(header) + BATCH_CHUNK * sizeof(struct batch_result);
+    char *work = malloc(work_size);
+    char *result = malloc(result_size);
+    struct batch_position *chunk = (struct batch_position *)(work + sizeof(header));
+    struct batch_result *results = (struct batch_result *)(result + sizeof(header));
+
+    while (1)
+    {
+        MPI_Recv(work, work_size, MPI_BYTE, 0, MPI_ANY_TAG, MPI_COMM_WORLD, &status);
+        if (status.MPI_TAG == BATCH_STOP)
+            break;
+        memcpy(header, work, sizeof(header));
+        for (int i = 0; i < header[1]; i++)
+            batch_analyse(&chunk[i], batch_depth, &results[i]);
+        memcpy(result, header, sizeof(header));
+        MPI_Send(result, sizeof(header) + header[1] * sizeof(struct batch_result), MPI_BYTE,
+                 0, BATCH_RESULT, MPI_COMM_WORLD);
+    }
+    free(work);
+    free(result);
+}
+
+/**
+ * Function to fill a chunk with up to BATCH_CHUNK positions.
+ *
+ * @param in
+ * @param chunk
+ * @param line  running line number for error messages
+ *
+ * @return number of positions read, 0 at end of input
+ */
+static int read_chunk(FILE *in, struct batch_position *chunk, long *line)
+{
+    int count = 0;
+    while (count < BATCH_CHUNK && batch_read_position(in, batch_binary, &chunk[count], line))
+        count++;
+    return count;
+}
+
+/**
+ * Function to read the next position from a batch file. Malformed input
+ * aborts the run, since skipping it would shift every later result.
+ *
+ * @param in
+ * @param binary
+ * @param pos
+ * @param line
+ *
+ * @return 1 if a position was read, 0 at end of input
+ */
+int batch_read_position(FILE *in, int binary, struct batch_position *pos, long *line)
+{
+    if (binary)
+    {
+        unsigned char rec[BATCH_RECORDSIZE];
+        size_t n = fread(rec, 1, BATCH_RECORDSIZE, in);
+        if (n == 0)
+            return 0;
+        (*line)++;
+        if (n != BATCH_RECORDSIZE || (rec[16] != BLACK && rec[16] != WHITE))
+        {
+            fprintf(stderr, "batch: bad record %ld\n", *line);
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        pos->black = 0;
+        pos->white = 0;
+        for (int i = 7; i >= 0; i--)
+        {
+            pos->black = (pos->black << 8) | rec[i];
+            pos->white = (pos->white << 8) | rec[8 + i];
+        }
+        /* a square cannot hold both colours */
+        if (pos->black & pos->white)
+        {
+            fprintf(stderr, "batch: bad record %ld\n", *line);
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        pos->player = rec[16];
+        return 1;
+    }
+
+    char text[256];
+    while (fgets(text, sizeof(text), in) != NULL)
+    {
+        (*line)++;
+        /* the position is at the start of a line, the rest is dropped */
+        if (strchr(text, '\n') == NULL && !feof(in))
+        {
+            int c;
+            while ((c = fgetc(in)) != EOF && c != '\n')
+                ;
+            fprintf(stderr, "batch: line %ld is longer than %zu bytes, the rest is ignored\n", *line,
+                    sizeof(text) - 1);
+        }
+        if (text[0] == '#' || text[0] == '\n' || text[0] == '\r')
+            continue;
+        if (batch_parse_position(text, pos) == FAILURE)
+        {
+            fprintf(stderr, "batch: bad position on line %ld\n", *line);
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * Function to parse a text position: 64 squares then the side to move.
+ *
+ * @param text
+ * @param pos
+ *
+ * @return SUCCESS or FAILURE
+ */
+int batch_parse_position(const char *text, struct batch_position *pos)
+{
+    int sq;
+    pos->black = 0;
+    pos->white = 0;
+    for (sq = 0; sq < 64; sq++)
+    {
+        switch (text[sq])
+        {
+        case 'b': case 'B': case 'x': case 'X': case '*':
+            pos->black |= 1ULL << sq;
+            break;
+        case 'w': case 'W': case 'o': case 'O':
+            pos->white |= 1ULL << sq;
+            break;
+        case '.': case '-': case '_':
+            break;
+        default:
+            return FAILURE;
+        }
+    }
+    text += 64;
+    while (*text == ' ' || *text == '\t')
+        text++;
+    if (*text == 'b' || *text == 'B' || *text == 'x' || *text == 'X' || *text == '*')
+        pos->player = BLACK;
+    else if (*text == 'w' || *text == 'W' || *text == 'o' || *text == 'O')
+        pos->player = WHITE;
+    else
+        return FAILURE;
+    return SUCCESS;
+}
+
+/**
+ * Function to copy a batch position onto the global board.
+ *
+ * @param pos
+ */
+void batch_load_position(const struct batch_position *pos)
+{
+    for (int sq = 0; sq < 64; sq++)
+    {
+        int loc = 10 * (sq / 8 + 1) + sq % 8 + 1;
+        if (pos->black & (1ULL << sq))
+            board[loc] = BLACK;
+        else if (pos->white & (1ULL << sq))
+            board[loc] = WHITE;
+        else
+            board[loc] = EMPTY;
+    }
+}
+
+/**
+ * Function to find the best move, its score and the number of nodes
+ * searched for a single position.
+ *
+ * @param pos
+ * @param depth
+ * @param res
+ */
+void batch_analyse(const struct batch_position *pos, int depth, struct batch_result *res)
+{
+    int root_moves[LEGALMOVSBUFSIZE];
+
+    batch_load_position(pos);
+    my_colour = pos->player;
+    nodes = 0;
+
+    memcpy(root_moves, legalmoves(my_colour), LEGALMOVSBUFSIZE * sizeof(int));
+    res->move = -1;
+    res->score = ALPHA;
+    if (root_moves[0] == 0)
+    {
+        /* a pass: the opponent's replies are searched, scored from my_colour's view */
+        uint64_t P, O;
+        bb_from_board(board, my_colour, &P, &O);
+        res->score = iterative_minimax(O, P, 1, depth, opponent(my_colour), ALPHA, BETA);
+    }
+    for (int i = 1; i <= root_moves[0]; i++)
+    {
+        int score = search_move(root_moves[i], my_colour, depth, res->score);
+        if (res->move == -1 || score > res->score)
+        {
+            res->move = root_moves[i];
+            res->score = score;
+        }
+    }
+    res->nodes = nodes;
+}
+
+/**
+ * Function to write one line per result: move, score and node count.
+ *
+ * @param out
+ * @param results
+ * @param count
+ */
+static void write_results(FILE *out, struct batch_result *results, int count)
+{
+    char ms[MOVEBUFSIZE];
+    for (int i = 0; i < count; i++)
+    {
+        if (results[i].move == -1)
+            strncpy(ms, "pass", MOVEBUFSIZE);
+        else
+        {
+            get_move_string(results[i].move, ms);
+            ms[2] = 0;
+        }
+        fprintf(out, "%s %d %lld\n", ms, results[i].score, results[i].nodes);
+    }
+}
@@ -0,0 +1,42 @@
+#ifndef _BATCH_H
+#define _BATCH_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/*
+    Batch analysis: positions are streamed from a file in chunks, handed
+    out to the worker ranks and the results are written back in input
+    order. Text input has one position per line: 64 squares (a1..h8, row
+    by row, 'b'/'X'/'*' black, 'w'/'O' white, '.'/'-' empty) followed by
+    the side to move. Binary input is a sequence of BATCH_RECORDSIZE byte
+    records: black mask, white mask (little endian, bit 0 = a1) and the
+    side to move (BLACK or WHITE).
+ */
+#define BATCH_CHUNK 1024
+#define BATCH_RECORDSIZE 17
+#define BATCH_WORK 10
+#define BATCH_RESULT 11
+#define BATCH_STOP 12
+
+struct batch_position
+{
+    uint64_t black;
+    uint64_t white;
+    int player;
+};
+
+struct batch_result
+{
+    int move;
+    int score;
+    long long nodes;
+};
+
+int batch_main(int argc, char *argv[]);
+int batch_read_position(FILE *in, int binary, struct batch_position *pos, long *line);
+int batch_parse_position(const char *text, struct batch_position *pos);
+void batch_load_position(const struct batch_position *pos);
+void batch_analyse(const struct batch_position *pos, int depth, struct batch_result *res);
+
+#endif
@@ -0,0 +1,239 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mpi.h>
+#include "comms.h"
+#include "player.h"
+#include "bitboard.h"
+#include "batch.h"
+#include "mpc.h"
+#include "mcts.h"
+#include "bench.h"
+#include "tt.h"
+
+#define START_BLACK 0x0000000810000000ULL
+#define START_WHITE 0x0000001008000000ULL
+
+static uint64_t bench_state;
+
+static int bench_parallel(struct batch_position *pos, int count, int depth);
+
+static uint64_t bench_random()
+{
+    bench_state ^= bench_state << 13;
+    bench_state ^= bench_state >> 7;
+    bench_state ^= bench_state << 17;
+    return bench_state;
+}
+
+/**
+ * Function to fill pos with positions reached by random playouts from
+ * the start, each stopped after a random number of plies. The same seed
+ * gives the same positions on every rank.
+ *
+ * @param pos
+ * @param n
+ * @param seed
+ * @param min_ply
+ * @param max_ply
+ */
+void bench_positions(struct batch_position *pos, int n, unsigned seed, int min_ply, int max_ply)
+{
+    bench_state = 0x9e3779b97f4a7c15ULL ^ seed;
+    for (int i = 0; i < n; i++)
+    {
+        int plies = min_ply + bench_random() % (max_ply - min_ply + 1);
+        uint64_t P = START_BLACK, O = START_WHITE, legal, tmp;
+        int player = BLACK;
+
+        for (int ply = 0; ply < plies; ply++)
+        {
+            legal = bb_moves(P, O);
+            if (legal == 0)
+            {
+                if (bb_moves(O, P) == 0)
+                    break;
+            }
+            else
+            {
+                int pick = bench_random() % __builtin_popcountll(legal);
+                while (pick--)
+                    legal &= legal - 1;
+                int sq = __builtin_ctzll(legal);
+                uint64_t flips = bb_flips(P, O, sq);
+                P ^= flips | (1ULL << sq);
+                O ^= flips;
+            }
+            tmp = P;
+            P = O;
+            O = tmp;
+            player = player == BLACK ? WHITE : BLACK;
+        }
+        pos[i].player = player;
+        pos[i].black = player == BLACK ? P : O;
+        pos[i].white = player == BLACK ? O : P;
+    }
+}
+
+/**
+ * Entry point for the benchmark, called on every rank. The positions
+ * are striped over the ranks and the totals are reduced on rank 0.
+ * Without --mpc only the full width columns are filled in. With
+ * --parallel the suite is instead searched one position at a time by
+ * all the ranks together, as in a game, with the --search mode given.
+ *
+ * Usage: main --bench [--depth d] [--count n] [--mpc t] [--parallel]
+ *
+ * @param argc
+ * @param argv
+ *
+ * @return SUCCESS
+ */
+int bench_main(int argc, char *argv[])
+{
+    int max_depth = 6, count = BENCH_COUNT, parallel = 0;
+    double selectivity = mpc_t;
+    struct batch_position *pos;
+    struct batch_result full, sel;
+
+    for (int i = 2; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--depth") == 0 && i + 1 < argc)
+            max_depth = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--count") == 0 && i + 1 < argc)
+            count = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--parallel") == 0)
+            parallel = 1;
+    }
+
+    pos = malloc(count * sizeof(struct batch_position));
+    bench_positions(pos, count, BENCH_SEED, 8, 52);
+    if (parallel)
+    {
+        int result = bench_parallel(pos, count, max_depth);
+        free(pos);
+        return result;
+    }
+    share_bounds = 0;
+
+    if (rank == 0)
+    {
+        printf("bench: %d positions, %s kernel, mpc %.2f\n", count, bb_kernel_name(bb_kernel), selectivity);
+        printf("depth  full-nodes full-time     mpc-nodes  mpc-time speedup  same-move  mean|diff|\n");
+    }
+    /* a root move searched to depth 1 is not searched at all, start at 2 */
+    for (int depth = 2; depth <= max_depth; depth++)
+    {
+        /* full nodes, mpc nodes, same move, score diff; full time, mpc time */
+        long long counts[4] = {0, 0, 0, 0}, total_counts[4];
+        double times[2] = {0, 0}, total_times[2];
+
+        for (int i = rank; i < count; i += size)
+        {
+            double t0 = MPI_Wtime();
+            mpc_t = 0.0;
+            batch_analyse(&pos[i], depth, &full);
+            times[0] += MPI_Wtime() - t0;
+            counts[0] += full.nodes;
+            if (selectivity <= 0)
+                continue;
+
+            t0 = MPI_Wtime();
+            mpc_t = selectivity;
+            batch_analyse(&pos[i], depth, &sel);
+            times[1] += MPI_Wtime() - t0;
+            counts[1] += sel.nodes;
+            counts[2] += sel.move == full.move;
+            counts[3] += abs(sel.score - full.score);
+        }
+        MPI_Reduce(counts, total_counts, 4, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+        MPI_Reduce(times, total_times, 2, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+        if (rank != 0)
+            continue;
+        if (selectivity <= 0)
+            printf("%5d %12lld %9.3f\n", depth, total_counts[0], total_times[0]);
+        else
+            printf("%5d %12lld %9.3f  %12lld %9.3f %6.2fx %9.1f%% %11.2f\n", depth, total_counts[0],
+                   total_times[0], total_counts[1], total_times[1],
+                   total_times[1] > 0 ? total_times[0] / total_times[1] : 0.0,
+                   100.0 * total_counts[2] / count, (double)total_counts[3] / count);
+    }
+    mpc_t = selectivity;
+    free(pos);
+    return SUCCESS;
+}
+
+/**
+ * Function to search the suite with parallel_search(), rank 0 driving
+ * the workers exactly as the game loop does. With one rank there are no
+ * workers, so rank 0 searches each position serially instead, giving
+ * the baseline runscaling.sh measures speedup and extra nodes against.
+ * Time the searching ranks are not searching is reported as
+ * communication: the busiest rank's idle share is time lost to
+ * messages and coordination, the rest of the mean's is load imbalance.
+ *
+ * @param pos
+ * @param count
+ * @param depth
+ *
+ * @return SUCCESS
+ */
+static int bench_parallel(struct batch_position *pos, int count, int depth)
+{
+    long long total_nodes = 0;
+    double total = 0, busy_max, busy_sum;
+    int score, over = 0;
+    int serial = size == 1 && search_mode != SEARCH_MCTS;
+    int searchers = search_mode == SEARCH_MCTS || size == 1 ? size : size - 1;
+    struct batch_result res;
+
+    search_depth = depth;
+    search_busy = 0;
+    if (rank != 0)
+        run_worker(rank);
+    else
+    {
+        if (serial && tt_table == NULL && tt_init(0) == FAILURE)
+        {
+            fprintf(stderr, "bench: cannot allocate the transposition table\n");
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        for (int i = 0; i < count; i++)
+        {
+            double start = MPI_Wtime();
+            if (serial)
+            {
+                tt_new_search();
+                batch_analyse(&pos[i], depth, &res);
+                search_busy += MPI_Wtime() - start;
+            }
+            else
+            {
+                batch_load_position(&pos[i]);
+                my_colour = pos[i].player;
+                parallel_search(&score);
+            }
+            total += MPI_Wtime() - start;
+            total_nodes += nodes;
+        }
+        for (int i = 1; i < size; i++)
+            MPI_Send(&over, 1, MPI_INT, i, STOP, MPI_COMM_WORLD);
+    }
+    MPI_Reduce(&search_busy, &busy_max, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&search_busy, &busy_sum, 1, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+    if (rank != 0)
+        return SUCCESS;
+
+    if (search_mode == SEARCH_MCTS)
+        printf("bench: mcts search, %d ranks x %d threads, %d ms, %d positions: %lld playouts %.3fs %.0f playouts/s\n",
+               size, mcts_threads, mcts_time, count, total_nodes, total, total > 0 ? total_nodes / total : 0.0);
+    else
+        printf("bench: %s search, %d ranks, depth %d, %d positions: %lld nodes %.3fs %.2f Mnps\n",
+               search_mode == SEARCH_LAZY ? "lazy" : "split", size, depth, count, total_nodes, total,
+               total > 0 ? total_nodes / total / 1e6 : 0.0);
+    if (total > 0)
+        printf("busy: max %.3fs mean %.3fs, communication %.1f%%, imbalance %.1f%%\n", busy_max,
+               busy_sum / searchers, 100.0 * (total - busy_max) / total,
+               100.0 * (busy_max - busy_sum / searchers) / total);
+    return SUCCESS;
+}
@@ -0,0 +1,18 @@
+#ifndef _BENCH_H
+#define _BENCH_H
+
+#include "batch.h"
+
+/*
+    Search benchmark: a fixed suite of positions from seeded random
+    playouts is searched at each depth up to the given one, full width
+    and with Multi-ProbCut, reporting time, nodes and how often the
+    selective search agrees with the full width one.
+ */
+#define BENCH_COUNT 64
+#define BENCH_SEED 20240601u
+
+void bench_positions(struct batch_position *pos, int n, unsigned seed, int min_ply, int max_ply);
+int bench_main(int argc, char *argv[]);
+
+#endif
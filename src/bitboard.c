@@ -0,0 +1,240 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <immintrin.h>
+#include "comms.h"
+#include "tables.h"
+#include "bitboard.h"
+
+/* O masked so that horizontal and diagonal runs cannot wrap a row */
+#define NOT_EDGE 0x7e7e7e7e7e7e7e7eULL
+
+uint64_t (*bb_moves)(uint64_t P, uint64_t O) = bb_moves_scalar;
+uint64_t (*bb_flips)(uint64_t P, uint64_t O, int sq) = bb_flips_scalar;
+int bb_kernel = BB_SCALAR;
+
+/**
+ * Function to select the move generation kernel. BB_AUTO uses AVX2 when
+ * the CPU has it; asking for AVX2 on a CPU without it falls back to the
+ * scalar kernel.
+ *
+ * @param kernel  BB_AUTO, BB_SCALAR or BB_AVX2
+ *
+ * @return the kernel in use
+ */
+int bb_init(int kernel)
+{
+    if (kernel == BB_AUTO || kernel == BB_AVX2)
+        kernel = bb_avx2_supported() ? BB_AVX2 : BB_SCALAR;
+
+    if (kernel == BB_AVX2)
+    {
+        bb_moves = bb_moves_avx2;
+        bb_flips = bb_flips_avx2;
+    }
+    else
+    {
+        bb_moves = bb_moves_scalar;
+        bb_flips = bb_flips_scalar;
+    }
+    bb_kernel = kernel;
+    return kernel;
+}
+
+int bb_kernel_from_name(const char *name)
+{
+    if (strcmp(name, "scalar") == 0)
+        return BB_SCALAR;
+    if (strcmp(name, "avx2") == 0)
+        return BB_AVX2;
+    return BB_AUTO;
+}
+
+const char *bb_kernel_name(int kernel)
+{
+    return kernel == BB_AVX2 ? "avx2" : kernel == BB_SCALAR ? "scalar" : "auto";
+}
+
+int bb_avx2_supported()
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+
+/*
+    Scalar kernel: one direction at a time. Each direction is a shift
+    left or right by 1 (horizontal), 8 (vertical), 7 or 9 (diagonal).
+ */
+#define RUN_LEFT(x, seed, mO, s)        \
+    x = (mO) & ((seed) << (s));         \
+    x |= (mO) & (x << (s));             \
+    x |= (mO) & (x << (s));             \
+    x |= (mO) & (x << (s));             \
+    x |= (mO) & (x << (s));             \
+    x |= (mO) & (x << (s))
+#define RUN_RIGHT(x, seed, mO, s)       \
+    x = (mO) & ((seed) >> (s));         \
+    x |= (mO) & (x >> (s));             \
+    x |= (mO) & (x >> (s));             \
+    x |= (mO) & (x >> (s));             \
+    x |= (mO) & (x >> (s));             \
+    x |= (mO) & (x >> (s))
+
+uint64_t bb_moves_scalar(uint64_t P, uint64_t O)
+{
+    uint64_t mO = O & NOT_EDGE;
+    uint64_t x, moves = 0;
+
+    RUN_LEFT(x, P, mO, 1);
+    moves |= x << 1;
+    RUN_RIGHT(x, P, mO, 1);
+    moves |= x >> 1;
+    RUN_LEFT(x, P, O, 8);
+    moves |= x << 8;
+    RUN_RIGHT(x, P, O, 8);
+    moves |= x >> 8;
+    RUN_LEFT(x, P, mO, 7);
+    moves |= x << 7;
+    RUN_RIGHT(x, P, mO, 7);
+    moves |= x >> 7;
+    RUN_LEFT(x, P, mO, 9);
+    moves |= x << 9;
+    RUN_RIGHT(x, P, mO, 9);
+    moves |= x >> 9;
+
+    return moves & ~(P | O);
+}
+
+uint64_t bb_flips_scalar(uint64_t P, uint64_t O, int sq)
+{
+    uint64_t m = 1ULL << sq;
+    uint64_t mO = O & NOT_EDGE;
+    uint64_t x, flips = 0;
+
+    RUN_LEFT(x, m, mO, 1);
+    if (P & (x << 1))
+        flips |= x;
+    RUN_RIGHT(x, m, mO, 1);
+    if (P & (x >> 1))
+        flips |= x;
+    RUN_LEFT(x, m, O, 8);
+    if (P & (x << 8))
+        flips |= x;
+    RUN_RIGHT(x, m, O, 8);
+    if (P & (x >> 8))
+        flips |= x;
+    RUN_LEFT(x, m, mO, 7);
+    if (P & (x << 7))
+        flips |= x;
+    RUN_RIGHT(x, m, mO, 7);
+    if (P & (x >> 7))
+        flips |= x;
+    RUN_LEFT(x, m, mO, 9);
+    if (P & (x << 9))
+        flips |= x;
+    RUN_RIGHT(x, m, mO, 9);
+    if (P & (x >> 9))
+        flips |= x;
+
+    return flips;
+}
+
+/*
+    AVX2 kernel: the four shift amounts (1, 8, 7, 9) sit in the four
+    64 bit lanes, so each instruction steps four directions at once and
+    the left and right halves cover all eight.
+ */
+__attribute__((target("avx2"))) static inline uint64_t or_lanes(__m256i v)
+{
+    __m128i x = _mm_or_si128(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    return _mm_cvtsi128_si64(x) | _mm_extract_epi64(x, 1);
+}
+
+__attribute__((target("avx2"))) uint64_t bb_moves_avx2(uint64_t P, uint64_t O)
+{
+    const __m256i shift = _mm256_set_epi64x(9, 7, 8, 1);
+    const __m256i mask = _mm256_set_epi64x(NOT_EDGE, NOT_EDGE, -1, NOT_EDGE);
+    __m256i PP = _mm256_set1_epi64x(P);
+    __m256i mO = _mm256_and_si256(_mm256_set1_epi64x(O), mask);
+    __m256i l, r;
+
+    l = _mm256_and_si256(mO, _mm256_sllv_epi64(PP, shift));
+    r = _mm256_and_si256(mO, _mm256_srlv_epi64(PP, shift));
+    for (int i = 0; i < 5; i++)
+    {
+        l = _mm256_or_si256(l, _mm256_and_si256(mO, _mm256_sllv_epi64(l, shift)));
+        r = _mm256_or_si256(r, _mm256_and_si256(mO, _mm256_srlv_epi64(r, shift)));
+    }
+    l = _mm256_or_si256(_mm256_sllv_epi64(l, shift), _mm256_srlv_epi64(r, shift));
+
+    return or_lanes(l) & ~(P | O);
+}
+
+__attribute__((target("avx2"))) uint64_t bb_flips_avx2(uint64_t P, uint64_t O, int sq)
+{
+    const __m256i shift = _mm256_set_epi64x(9, 7, 8, 1);
+    const __m256i mask = _mm256_set_epi64x(NOT_EDGE, NOT_EDGE, -1, NOT_EDGE);
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i PP = _mm256_set1_epi64x(P);
+    __m256i mm = _mm256_set1_epi64x(1ULL << sq);
+    __m256i mO = _mm256_and_si256(_mm256_set1_epi64x(O), mask);
+    __m256i l, r, bl, br;
+
+    l = _mm256_and_si256(mO, _mm256_sllv_epi64(mm, shift));
+    r = _mm256_and_si256(mO, _mm256_srlv_epi64(mm, shift));
+    for (int i = 0; i < 5; i++)
+    {
+        l = _mm256_or_si256(l, _mm256_and_si256(mO, _mm256_sllv_epi64(l, shift)));
+        r = _mm256_or_si256(r, _mm256_and_si256(mO, _mm256_srlv_epi64(r, shift)));
+    }
+    /* keep a run only if one of P's discs closes it */
+    bl = _mm256_cmpeq_epi64(_mm256_and_si256(PP, _mm256_sllv_epi64(l, shift)), zero);
+    br = _mm256_cmpeq_epi64(_mm256_and_si256(PP, _mm256_srlv_epi64(r, shift)), zero);
+    l = _mm256_or_si256(_mm256_andnot_si256(bl, l), _mm256_andnot_si256(br, r));
+
+    return or_lanes(l);
+}
+
+/**
+ * Function to build the bitboards of a mailbox board.
+ *
+ * @param board
+ * @param player  side whose discs go in P
+ * @param P
+ * @param O
+ */
+void bb_from_board(int *board, int player, uint64_t *P, uint64_t *O)
+{
+    *P = 0;
+    *O = 0;
+    for (int sq = 0; sq < 64; sq++)
+    {
+        int piece = board[PLAYABLE[sq]];
+        if (piece == player)
+            *P |= 1ULL << sq;
+        else if (piece == OPPONENT[player])
+            *O |= 1ULL << sq;
+    }
+}
+
+/**
+ * Function to write bitboards back to the playable squares of a
+ * mailbox board.
+ *
+ * @param P
+ * @param O
+ * @param player  side whose discs are in P
+ * @param board
+ */
+void bb_to_board(uint64_t P, uint64_t O, int player, int *board)
+{
+    for (int sq = 0; sq < 64; sq++)
+    {
+        if (P & (1ULL << sq))
+            board[PLAYABLE[sq]] = player;
+        else if (O & (1ULL << sq))
+            board[PLAYABLE[sq]] = OPPONENT[player];
+        else
+            board[PLAYABLE[sq]] = EMPTY;
+    }
+}
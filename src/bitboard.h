@@ -0,0 +1,39 @@
+#ifndef _BITBOARD_H
+#define _BITBOARD_H
+
+#include <stdint.h>
+
+/*
+    Bitboards: one 64 bit mask per side, bit 0 = top left square, row by
+    row (the same order as the batch and PLAYABLE tables). The search
+    works on a pair (P, O) of the side to move and its opponent.
+
+    Move generation and flip computation have a scalar kernel and an
+    AVX2 kernel that runs four directions per instruction. bb_init()
+    picks one from the CPU features at startup and points bb_moves and
+    bb_flips at it.
+ */
+#define BB_AUTO 0
+#define BB_SCALAR 1
+#define BB_AVX2 2
+
+/* legal moves for P as a mask of empty squares */
+extern uint64_t (*bb_moves)(uint64_t P, uint64_t O);
+/* discs of O flipped when P plays on square sq (0 if the move is illegal) */
+extern uint64_t (*bb_flips)(uint64_t P, uint64_t O, int sq);
+extern int bb_kernel;
+
+int bb_init(int kernel);
+int bb_kernel_from_name(const char *name);
+const char *bb_kernel_name(int kernel);
+int bb_avx2_supported();
+
+uint64_t bb_moves_scalar(uint64_t P, uint64_t O);
+uint64_t bb_flips_scalar(uint64_t P, uint64_t O, int sq);
+uint64_t bb_moves_avx2(uint64_t P, uint64_t O);
+uint64_t bb_flips_avx2(uint64_t P, uint64_t O, int sq);
+
+void bb_from_board(int *board, int player, uint64_t *P, uint64_t *O);
+void bb_to_board(uint64_t P, uint64_t O, int player, int *board);
+
+#endif
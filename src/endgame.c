@@ -0,0 +1,464 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mpi.h>
+#include "comms.h"
+#include "player.h"
+#include "bitboard.h"
+#include "batch.h"
+#include "endgame.h"
+
+/* a split node on rank 0: its children, the next to hand out and its window */
+struct split_frame
+{
+    const uint64_t *children;
+    int n;
+    int next;
+    int in_flight;
+    int node;
+    int alpha;
+    int beta;
+    int best;
+};
+
+static int split_depth = ENDGAME_SPLIT;
+static int threshold = ENDGAME_THRESHOLD;
+static int *idle;
+static int num_idle;
+static int next_node;
+static struct endgame_entry *table;
+static struct split_frame *frame; /* set while rank 0 solves one of its children */
+static int stopped;               /* the frame was cut off, unwind */
+
+static int order_children(uint64_t P, uint64_t O, uint64_t legal, int first, uint64_t *children, int *squares);
+static int final_score(uint64_t P, uint64_t O);
+static int split_solve(uint64_t P, uint64_t O, int alpha, int beta, int depth);
+static void hand_out(struct split_frame *f);
+static void take_result(struct split_frame *f);
+static void update(struct split_frame *f, int score);
+static void endgame_poll();
+static void endgame_worker();
+
+/**
+ * Entry point for solving, called on every rank. Rank 0 reads the
+ * positions and prints one line per position; the other ranks serve
+ * tasks until it is done.
+ *
+ * @param argc
+ * @param argv
+ *
+ * @return SUCCESS
+ */
+int endgame_main(int argc, char *argv[])
+{
+    int binary = 0;
+    struct batch_position pos;
+    long line = 0;
+    FILE *in;
+
+    for (int i = 3; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--binary") == 0)
+            binary = 1;
+        else if (strcmp(argv[i], "--split") == 0 && i + 1 < argc)
+            split_depth = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc)
+            threshold = atoi(argv[++i]);
+    }
+
+    table = calloc((size_t)1 << ENDGAME_TTBITS, sizeof(struct endgame_entry));
+    if (table == NULL)
+    {
+        fprintf(stderr, "solve: cannot allocate the table\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    if (rank != 0)
+    {
+        endgame_worker();
+        free(table);
+        return SUCCESS;
+    }
+
+    in = fopen(argv[2], binary ? "rb" : "r");
+    if (in == NULL)
+    {
+        fprintf(stderr, "solve: cannot open %s\n", argv[2]);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    idle = malloc(size * sizeof(int));
+    for (int i = 1; i < size; i++)
+        idle[num_idle++] = i;
+
+    double total = 0;
+    long long total_nodes = 0;
+    printf("solve: %d ranks, split %d plies, threshold %d empties, table %zu bytes per rank\n", size, split_depth,
+           threshold, ((size_t)1 << ENDGAME_TTBITS) * sizeof(struct endgame_entry));
+    printf("  #  empties  score         nodes      time      Mnps\n");
+    for (int n = 1; batch_read_position(in, binary, &pos, &line); n++)
+    {
+        uint64_t P = pos.player == BLACK ? pos.black : pos.white;
+        uint64_t O = pos.player == BLACK ? pos.white : pos.black;
+        double start = MPI_Wtime();
+        long long worker_nodes = 0;
+
+        nodes = 0;
+        int score = split_solve(P, O, -64, 64, 0);
+
+        /* wait for abandoned tasks so every worker is free for the next position */
+        while (num_idle < size - 1)
+        {
+            struct endgame_result res;
+            MPI_Status status;
+            MPI_Recv(&res, sizeof(res), MPI_BYTE, MPI_ANY_SOURCE, ENDGAME_RESULT, MPI_COMM_WORLD, &status);
+            idle[num_idle++] = status.MPI_SOURCE;
+            worker_nodes += res.nodes;
+        }
+        double elapsed = MPI_Wtime() - start;
+        nodes += worker_nodes;
+        total += elapsed;
+        total_nodes += nodes;
+        printf("%3d  %7d  %+5d  %12lld  %8.3fs  %8.2f\n", n, 64 - __builtin_popcountll(P | O), score,
+               nodes, elapsed, elapsed > 0 ? nodes / elapsed / 1e6 : 0.0);
+        fflush(stdout);
+    }
+    printf("total            %12lld  %8.3fs  %8.2f\n", total_nodes, total,
+           total > 0 ? total_nodes / total / 1e6 : 0.0);
+    fclose(in);
+
+    for (int i = 1; i < size; i++)
+        MPI_Send(NULL, 0, MPI_BYTE, i, ENDGAME_STOP, MPI_COMM_WORLD);
+    free(idle);
+    free(table);
+    return SUCCESS;
+}
+
+/**
+ * Function to solve a position on this rank alone. Fail soft negamax
+ * alpha-beta. From ENDGAME_TTMIN empties up the bounds found go in the
+ * table and its move is tried first; from ENDGAME_ORDER empties up
+ * children are searched in order of the opponent's mobility, fewest
+ * first, and below that moves in regions (quadrants) with an odd number
+ * of empties go first.
+ *
+ * @param P      side to move
+ * @param O
+ * @param alpha
+ * @param beta
+ *
+ * @return final disc difference for P, or a bound outside (alpha, beta)
+ */
+int endgame_solve(uint64_t P, uint64_t O, int alpha, int beta)
+{
+    static const uint64_t quadrants[4] = {0x000000000f0f0f0fULL, 0x00000000f0f0f0f0ULL, 0x0f0f0f0f00000000ULL,
+                                          0xf0f0f0f000000000ULL};
+    uint64_t legal, empty = ~(P | O), children[2 * 32];
+    int squares[32], empties = __builtin_popcountll(empty);
+    int best = -65, best_move = ENDGAME_NOMOVE, hash_move = ENDGAME_NOMOVE;
+    struct endgame_entry *e = NULL;
+
+    nodes++;
+    if (frame != NULL && (nodes & ENDGAME_POLL) == 0)
+        endgame_poll();
+    if (stopped)
+        return alpha;
+    legal = bb_moves(P, O);
+    if (legal == 0)
+    {
+        if (bb_moves(O, P) == 0)
+            return final_score(P, O);
+        return -endgame_solve(O, P, -beta, -alpha);
+    }
+
+    if (empties >= ENDGAME_TTMIN)
+    {
+        e = &table[((P * 0x9e3779b97f4a7c15ULL) ^ (O * 0xc2b2ae3d27d4eb4fULL)) >> (64 - ENDGAME_TTBITS)];
+        if (e->P == P && e->O == O)
+        {
+            if (e->lower >= beta || e->lower == e->upper)
+                return e->lower;
+            if (e->upper <= alpha)
+                return e->upper;
+            if (e->lower > alpha)
+                alpha = e->lower;
+            if (e->upper < beta)
+                beta = e->upper;
+            hash_move = e->move;
+        }
+    }
+    int alpha0 = alpha;
+
+    if (empties >= ENDGAME_ORDER)
+    {
+        int n = order_children(P, O, legal, hash_move, children, squares);
+        for (int i = 0; i < n; i++)
+        {
+            int score = -endgame_solve(children[2 * i], children[2 * i + 1], -beta, -alpha);
+            if (score > best)
+            {
+                best = score;
+                best_move = squares[i];
+                if (score > alpha)
+                    alpha = score;
+                if (alpha >= beta)
+                    break;
+            }
+        }
+    }
+    else
+    {
+        /* odd regions first: the last move in a region is worth having */
+        uint64_t odd = 0;
+        for (int q = 0; q < 4; q++)
+        {
+            if (__builtin_popcountll(empty & quadrants[q]) & 1)
+                odd |= quadrants[q];
+        }
+        for (int pass = 0; pass < 2 && alpha < beta; pass++)
+        {
+            for (uint64_t moves = legal & (pass ? ~odd : odd); moves; moves &= moves - 1)
+            {
+                int sq = __builtin_ctzll(moves);
+                uint64_t flips = bb_flips(P, O, sq);
+                int score = -endgame_solve(O ^ flips, P ^ flips ^ (1ULL << sq), -beta, -alpha);
+                if (score > best)
+                {
+                    best = score;
+                    if (score > alpha)
+                        alpha = score;
+                    if (alpha >= beta)
+                        break;
+                }
+            }
+        }
+    }
+
+    if (e != NULL && !stopped)
+    {
+        int lower = best >= beta ? best : best > alpha0 ? best : -64;
+        int upper = best <= alpha0 ? best : best < beta ? best : 64;
+        if (e->P == P && e->O == O)
+        {
+            /* both are true bounds, keep the tighter of each */
+            if (e->lower > lower)
+                lower = e->lower;
+            if (e->upper < upper)
+                upper = e->upper;
+        }
+        e->P = P;
+        e->O = O;
+        e->lower = lower;
+        e->upper = upper;
+        e->move = best_move;
+    }
+    return best;
+}
+
+/**
+ * Function to solve a position on rank 0, splitting it over the workers
+ * if it is big enough.
+ *
+ * @param P
+ * @param O
+ * @param alpha
+ * @param beta
+ * @param depth  plies below the root
+ *
+ * @return as endgame_solve()
+ */
+static int split_solve(uint64_t P, uint64_t O, int alpha, int beta, int depth)
+{
+    uint64_t legal, children[2 * 32];
+    int squares[32], n;
+
+    if (size == 1 || depth >= split_depth || __builtin_popcountll(~(P | O)) <= threshold)
+        return endgame_solve(P, O, alpha, beta);
+
+    nodes++;
+    legal = bb_moves(P, O);
+    if (legal == 0)
+    {
+        if (bb_moves(O, P) == 0)
+            return final_score(P, O);
+        return -split_solve(O, P, -beta, -alpha, depth + 1);
+    }
+    n = order_children(P, O, legal, ENDGAME_NOMOVE, children, squares);
+
+    /* the eldest brother first, to get a window for the others */
+    struct split_frame f = {children, n, 1, 0, ++next_node, alpha, beta, 0};
+    f.best = -split_solve(children[0], children[1], -beta, -alpha, depth + 1);
+    if (f.best > f.alpha)
+        f.alpha = f.best;
+
+    while ((f.next < n || f.in_flight > 0) && f.alpha < f.beta)
+    {
+        int available = 0;
+        MPI_Status status;
+
+        hand_out(&f);
+        if (f.next < n)
+            MPI_Iprobe(MPI_ANY_SOURCE, ENDGAME_RESULT, MPI_COMM_WORLD, &available, &status);
+        if (f.next < n && !available)
+        {
+            /* every worker is busy: take the next child here, polling
+               for results and handing out the rest as workers come free */
+            int i = f.next++;
+            frame = &f;
+            int score = -endgame_solve(children[2 * i], children[2 * i + 1], -f.beta, -f.alpha);
+            frame = NULL;
+            if (stopped)
+                stopped = 0; /* cut off by a worker's result, the score is void */
+            else
+                update(&f, score);
+        }
+        else
+            take_result(&f);
+    }
+    return f.best;
+}
+
+/*
+    Send queued children of a split node to the idle workers.
+ */
+static void hand_out(struct split_frame *f)
+{
+    while (f->next < f->n && num_idle > 0)
+    {
+        struct endgame_task task = {f->children[2 * f->next], f->children[2 * f->next + 1], -f->beta, -f->alpha,
+                                    f->node, f->next};
+        MPI_Send(&task, sizeof(task), MPI_BYTE, idle[--num_idle], ENDGAME_TASK, MPI_COMM_WORLD);
+        f->next++;
+        f->in_flight++;
+    }
+}
+
+/*
+    Wait for a worker's result and count it against a split node.
+ */
+static void take_result(struct split_frame *f)
+{
+    struct endgame_result res;
+    MPI_Status status;
+
+    MPI_Recv(&res, sizeof(res), MPI_BYTE, MPI_ANY_SOURCE, ENDGAME_RESULT, MPI_COMM_WORLD, &status);
+    idle[num_idle++] = status.MPI_SOURCE;
+    nodes += res.nodes;
+    if (res.node != f->node)
+        return; /* left over from a node that was cut off */
+    f->in_flight--;
+    update(f, -res.score);
+}
+
+static void update(struct split_frame *f, int score)
+{
+    if (score > f->best)
+    {
+        f->best = score;
+        if (score > f->alpha)
+            f->alpha = score;
+    }
+}
+
+/*
+    Called from endgame_solve() on rank 0 while it solves a child of a
+    split node: take in the results that have come, keep the workers
+    busy, and stop the local solve if the node is cut off.
+ */
+static void endgame_poll()
+{
+    int available;
+    MPI_Status status;
+
+    MPI_Iprobe(MPI_ANY_SOURCE, ENDGAME_RESULT, MPI_COMM_WORLD, &available, &status);
+    while (available)
+    {
+        take_result(frame);
+        if (frame->alpha >= frame->beta)
+        {
+            stopped = 1;
+            return;
+        }
+        hand_out(frame);
+        MPI_Iprobe(MPI_ANY_SOURCE, ENDGAME_RESULT, MPI_COMM_WORLD, &available, &status);
+    }
+}
+
+/*
+    Worker ranks: solve tasks until told to stop.
+ */
+static void endgame_worker()
+{
+    struct endgame_task task;
+    struct endgame_result res;
+    MPI_Status status;
+
+    while (1)
+    {
+        MPI_Recv(&task, sizeof(task), MPI_BYTE, 0, MPI_ANY_TAG, MPI_COMM_WORLD, &status);
+        if (status.MPI_TAG == ENDGAME_STOP)
+            break;
+        nodes = 0;
+        res.node = task.node;
+        res.score = endgame_solve(task.P, task.O, task.alpha, task.beta);
+        res.nodes = nodes;
+        MPI_Send(&res, sizeof(res), MPI_BYTE, 0, ENDGAME_RESULT, MPI_COMM_WORLD);
+    }
+}
+
+/**
+ * Function to build the children of a position, fewest opponent moves
+ * first, corners counting as two extra moves.
+ *
+ * @param P
+ * @param O
+ * @param legal
+ * @param first     square to put before all others, ENDGAME_NOMOVE if none
+ * @param children  pairs of (side to move, opponent) for each child
+ * @param squares   the square played for each child
+ *
+ * @return number of children
+ */
+static int order_children(uint64_t P, uint64_t O, uint64_t legal, int first, uint64_t *children, int *squares)
+{
+    const uint64_t corners = 0x8100000000000081ULL;
+    int keys[32], n = 0;
+
+    for (; legal; legal &= legal - 1)
+    {
+        int sq = __builtin_ctzll(legal);
+        uint64_t flips = bb_flips(P, O, sq);
+        uint64_t mine = O ^ flips, theirs = P ^ flips ^ (1ULL << sq);
+        uint64_t replies = bb_moves(mine, theirs);
+        int key = sq == first ? -1 : __builtin_popcountll(replies) + 2 * __builtin_popcountll(replies & corners);
+        int i = n++;
+
+        /* insertion sort, stable so equal keys keep square order */
+        while (i > 0 && keys[i - 1] > key)
+        {
+            keys[i] = keys[i - 1];
+            children[2 * i] = children[2 * i - 2];
+            children[2 * i + 1] = children[2 * i - 1];
+            squares[i] = squares[i - 1];
+            i--;
+        }
+        keys[i] = key;
+        children[2 * i] = mine;
+        children[2 * i + 1] = theirs;
+        squares[i] = sq;
+    }
+    return n;
+}
+
+/*
+    Score of a finished game for P, empties go to the winner.
+ */
+static int final_score(uint64_t P, uint64_t O)
+{
+    int p = __builtin_popcountll(P), o = __builtin_popcountll(O);
+    int empties = 64 - p - o;
+
+    if (p > o)
+        return p - o + empties;
+    if (p < o)
+        return p - o - empties;
+    return 0;
+}
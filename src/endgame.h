@@ -0,0 +1,72 @@
+#ifndef _ENDGAME_H
+#define _ENDGAME_H
+
+#include <stdint.h>
+
+/*
+    Exact endgame solver: the final disc difference with perfect play,
+    from the side to move's view, empties going to the winner.
+
+    With more than one rank the tree is split below the root, young
+    brothers wait style. Rank 0 walks the top of the tree; at a split
+    node it searches the first child itself, then puts the remaining
+    children on a work queue of (position, window) tasks. Each task is
+    handed out only when a worker is free, with the window as it is at
+    that moment, so later siblings get the bounds the earlier ones
+    raised. While every worker is busy rank 0 solves a queued child
+    itself, checking for results every ENDGAME_POLL + 1 nodes so that
+    workers coming free get the rest of the queue at once; a result that
+    cuts the node off stops the local solve. A cutoff abandons the node
+    and its outstanding results are dropped when they arrive. Nodes
+    deeper than ENDGAME_SPLIT plies, or with ENDGAME_THRESHOLD empties
+    or fewer, are never split: their subtrees are too small to be worth
+    a message.
+
+    Each rank keeps a table of score bounds and best moves, kept across
+    positions; below ENDGAME_ORDER empties moves in quadrants with an odd
+    number of empties are tried first.
+        main --solve <positions> [--binary] [--split n] [--threshold n]
+    Positions are read like --batch input, so FFO .obf lines work as is.
+ */
+#define ENDGAME_SPLIT 3
+#define ENDGAME_THRESHOLD 12
+#define ENDGAME_ORDER 5 /* fastest first ordering from this many empties */
+#define ENDGAME_TTBITS 19 /* 2^19 entries of 24 bytes per rank */
+#define ENDGAME_TTMIN 5   /* empties from which nodes go in the table */
+#define ENDGAME_POLL 1023 /* rank 0 node mask between checks for results */
+#define ENDGAME_TASK 20
+#define ENDGAME_RESULT 21
+#define ENDGAME_STOP 22
+#define ENDGAME_NOMOVE 64
+
+struct endgame_task
+{
+    uint64_t P;
+    uint64_t O;
+    int alpha;
+    int beta;
+    int node; /* split node the task belongs to */
+    int index;
+};
+
+/* exact bounds of a position's score, the whole position being the key */
+struct endgame_entry
+{
+    uint64_t P;
+    uint64_t O;
+    int8_t lower;
+    int8_t upper;
+    uint8_t move; /* best or cutting square, ENDGAME_NOMOVE if none */
+};
+
+struct endgame_result
+{
+    int node;
+    int score;
+    long long nodes;
+};
+
+int endgame_main(int argc, char *argv[]);
+int endgame_solve(uint64_t P, uint64_t O, int alpha, int beta);
+
+#endif
@@ -0,0 +1,569 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <immintrin.h>
+#include "comms.h"
+#include "player.h"
+#include "tables.h"
+#include "bitboard.h"
+#include "evaluate.h"
+
+#define NOT_EDGE 0x7e7e7e7e7e7e7e7eULL
+#define COL_A 0x0101010101010101ULL
+#define COL_H 0x8080808080808080ULL
+#define ROW_1 0x00000000000000ffULL
+#define ROW_8 0xff00000000000000ULL
+
+/*
+    weights[] in bit order, and the same table as bit planes: square sq
+    is in planes[k] if bit k of (weight - weight_base) is set, so a
+    weighted sum over a mask is weight_base * popcount(mask) plus
+    popcount(mask & planes[k]) << k.
+ */
+static int bit_weights[64];
+static uint64_t planes[EVAL_MAXPLANES];
+static int num_planes;
+static int weight_base;
+
+/* heavy weights or pattern tables can add up past the search window */
+static inline int clamp_score(int score)
+{
+    return score > EVAL_MAXSCORE ? EVAL_MAXSCORE : score < -EVAL_MAXSCORE ? -EVAL_MAXSCORE : score;
+}
+
+int eval_coef[EVAL_TERMS] = {1, 20, 3};
+int eval_patterns = 0;
+int16_t edge_table[EVAL_EDGESIZE];
+int16_t corner_table[EVAL_CORNERSIZE];
+
+/* pattern instances, each listed from its corner so they share a table */
+static const int EDGE_SQUARES[EVAL_INSTANCES][EVAL_EDGE] = {
+    {0, 1, 2, 3, 4, 5, 6, 7},
+    {56, 57, 58, 59, 60, 61, 62, 63},
+    {0, 8, 16, 24, 32, 40, 48, 56},
+    {7, 15, 23, 31, 39, 47, 55, 63}};
+static const int CORNER_SQUARES[EVAL_INSTANCES][EVAL_CORNER] = {
+    {0, 1, 2, 8, 9, 10, 16, 17, 18},
+    {7, 6, 5, 15, 14, 13, 23, 22, 21},
+    {56, 57, 58, 48, 49, 50, 40, 41, 42},
+    {63, 62, 61, 55, 54, 53, 47, 46, 45}};
+
+/**
+ * Function to rebuild the bit order weights and the weight planes.
+ * Called at startup and whenever weights[] changes.
+ */
+void evaluate_init()
+{
+    int top;
+
+    weight_base = weights[PLAYABLE[0]];
+    top = weight_base;
+    for (int sq = 0; sq < 64; sq++)
+    {
+        bit_weights[sq] = weights[PLAYABLE[sq]];
+        if (bit_weights[sq] < weight_base)
+            weight_base = bit_weights[sq];
+        if (bit_weights[sq] > top)
+            top = bit_weights[sq];
+    }
+    for (num_planes = 0; num_planes < EVAL_MAXPLANES && (top - weight_base) >> num_planes; num_planes++)
+    {
+        planes[num_planes] = 0;
+        for (int sq = 0; sq < 64; sq++)
+        {
+            if (((bit_weights[sq] - weight_base) >> num_planes) & 1)
+                planes[num_planes] |= 1ULL << sq;
+        }
+    }
+}
+
+/**
+ * Funciton to evaluate the state of the board
+ * after a certan move was made
+ *
+ * @param P  discs of the side the score is for
+ * @param O  discs of its opponent
+ *
+ * @return evaluation rating
+ */
+int evaluate_board(uint64_t P, uint64_t O)
+{
+    int player_moves, opp_moves;
+    uint64_t mobility;
+    player_moves = 0;
+    opp_moves = 0;
+    for (mobility = bb_moves(P, O); mobility; mobility &= mobility - 1)
+        player_moves = bit_weights[__builtin_ctzll(mobility)] + player_moves;
+    for (mobility = bb_moves(O, P); mobility; mobility &= mobility - 1)
+        opp_moves = bit_weights[__builtin_ctzll(mobility)] + opp_moves;
+
+    if (eval_patterns)
+        return clamp_score(eval_coef[EVAL_MOBILITY] * (player_moves - opp_moves) + evaluate_terms(P, O) +
+                           evaluate_patterns(P, O));
+    return clamp_score(eval_coef[EVAL_MOBILITY] * (player_moves - opp_moves) + evaluate_terms(P, O));
+}
+
+/*
+    Full lines: a row or column is folded onto its first square with
+    three shifts, then spread back over the line with a multiply. A
+    diagonal is full where the run of discs from a square reaches the
+    edge both ways; runs grow in steps of 1, 2 and 4 squares, and a step
+    that leaves the board counts as a disc.
+
+    A disc can only be stable if it is a corner or its row or column is
+    full, so without those the diagonals are skipped and 0 returned.
+ */
+#define ROWS_FROM(r) (~0ULL << (8 * (r)))
+#define ROWS_BELOW(r) (~ROWS_FROM(r))
+#define COLS_BELOW(c) (((1ULL << (c)) - 1) * COL_A)
+#define COLS_FROM(c) (~COLS_BELOW(c))
+#define CORNERS 0x8100000000000081ULL
+
+static int full_lines(uint64_t occupied, uint64_t *h, uint64_t *v, uint64_t *d7, uint64_t *d9)
+{
+    uint64_t x, y;
+
+    x = occupied & (occupied >> 1);
+    x &= x >> 2;
+    x &= x >> 4;
+    *h = (x & COL_A) * 0xff;
+    x = occupied & (occupied >> 8);
+    x &= x >> 16;
+    x &= x >> 32;
+    *v = (x & ROW_1) * COL_A;
+    if ((occupied & CORNERS) == 0 && (*h | *v) == 0)
+        return 0;
+
+    x = occupied & ((occupied >> 9) | ROWS_FROM(7) | COLS_FROM(7));
+    x &= (x >> 18) | ROWS_FROM(6) | COLS_FROM(6);
+    x &= (x >> 36) | ROWS_FROM(4) | COLS_FROM(4);
+    y = occupied & ((occupied << 9) | ROWS_BELOW(1) | COLS_BELOW(1));
+    y &= (y << 18) | ROWS_BELOW(2) | COLS_BELOW(2);
+    y &= (y << 36) | ROWS_BELOW(4) | COLS_BELOW(4);
+    *d9 = x & y;
+    x = occupied & ((occupied >> 7) | ROWS_FROM(7) | COLS_BELOW(1));
+    x &= (x >> 14) | ROWS_FROM(6) | COLS_BELOW(2);
+    x &= (x >> 28) | ROWS_FROM(4) | COLS_BELOW(4);
+    y = occupied & ((occupied << 7) | ROWS_BELOW(1) | COLS_FROM(7));
+    y &= (y << 14) | ROWS_BELOW(2) | COLS_FROM(6);
+    y &= (y << 28) | ROWS_BELOW(4) | COLS_FROM(4);
+    *d7 = x & y;
+    return 1;
+}
+
+/*
+    Grows P's stable discs from nothing until they stop changing. A
+    shifted set that wraps a row lands on the edge, which passes anyway.
+ */
+static uint64_t stable_discs(uint64_t P, uint64_t h, uint64_t v, uint64_t d7, uint64_t d9)
+{
+    const uint64_t edge = COL_A | COL_H | ROW_1 | ROW_8;
+    uint64_t stable = 0, last;
+
+    h |= COL_A | COL_H;
+    v |= ROW_1 | ROW_8;
+    d7 |= edge;
+    d9 |= edge;
+    do
+    {
+        last = stable;
+        stable = P & (h | (stable << 1) | (stable >> 1)) & (v | (stable << 8) | (stable >> 8)) &
+                 (d7 | (stable << 7) | (stable >> 7)) & (d9 | (stable << 9) | (stable >> 9));
+    } while (stable != last);
+    return stable;
+}
+
+/**
+ * Function to find the discs of P that can never be flipped.
+ *
+ * @param P
+ * @param O
+ *
+ * @return mask of P's stable discs
+ */
+uint64_t evaluate_stable(uint64_t P, uint64_t O)
+{
+    uint64_t h, v, d7, d9;
+
+    if (!full_lines(P | O, &h, &v, &d7, &d9))
+        return 0;
+    return stable_discs(P, h, v, d7, d9);
+}
+
+/* squares next to a disc of x, in any of the eight directions */
+static uint64_t neighbours(uint64_t x)
+{
+    uint64_t east = (x << 1) & ~COL_A, west = (x >> 1) & ~COL_H;
+    uint64_t row = x | east | west;
+    return east | west | (row << 8) | (row >> 8);
+}
+
+/**
+ * Function to score the stability and potential mobility terms for P,
+ * skipping any whose coefficient is 0.
+ *
+ * @param P
+ * @param O
+ *
+ * @return sum of the terms times their coefficients
+ */
+int evaluate_terms(uint64_t P, uint64_t O)
+{
+    uint64_t h, v, d7, d9;
+    int score = 0;
+
+    if (eval_coef[EVAL_STABILITY] && full_lines(P | O, &h, &v, &d7, &d9))
+    {
+        score += eval_coef[EVAL_STABILITY] * (__builtin_popcountll(stable_discs(P, h, v, d7, d9)) -
+                                              __builtin_popcountll(stable_discs(O, h, v, d7, d9)));
+    }
+    if (eval_coef[EVAL_FRONTIER])
+    {
+        uint64_t empty = ~(P | O);
+        score += eval_coef[EVAL_FRONTIER] * (__builtin_popcountll(empty & neighbours(O)) -
+                                             __builtin_popcountll(empty & neighbours(P)));
+    }
+    return score;
+}
+
+/**
+ * Function to read coefficients written as "m,s,f".
+ *
+ * @param text
+ * @param coef  EVAL_TERMS coefficients, left alone on failure
+ *
+ * @return SUCCESS or FAILURE
+ */
+int evaluate_parse_coef(const char *text, int *coef)
+{
+    int c[EVAL_TERMS];
+
+    if (sscanf(text, "%d,%d,%d", &c[EVAL_MOBILITY], &c[EVAL_STABILITY], &c[EVAL_FRONTIER]) != EVAL_TERMS)
+        return FAILURE;
+    memcpy(coef, c, sizeof(c));
+    return SUCCESS;
+}
+
+/**
+ * Function to get the pattern indices of a position, from P's view.
+ *
+ * @param P
+ * @param O
+ * @param edge    EVAL_INSTANCES edge indices
+ * @param corner  EVAL_INSTANCES corner indices
+ */
+void evaluate_pattern_indices(uint64_t P, uint64_t O, int *edge, int *corner)
+{
+    for (int k = 0; k < EVAL_INSTANCES; k++)
+    {
+        int index = 0;
+        for (int i = EVAL_EDGE - 1; i >= 0; i--)
+        {
+            int sq = EDGE_SQUARES[k][i];
+            index = index * 3 + ((P >> sq) & 1) + 2 * ((O >> sq) & 1);
+        }
+        edge[k] = index;
+        index = 0;
+        for (int i = EVAL_CORNER - 1; i >= 0; i--)
+        {
+            int sq = CORNER_SQUARES[k][i];
+            index = index * 3 + ((P >> sq) & 1) + 2 * ((O >> sq) & 1);
+        }
+        corner[k] = index;
+    }
+}
+
+/**
+ * Function to score the pattern tables for P.
+ *
+ * @param P
+ * @param O
+ *
+ * @return sum of the table entries of every instance
+ */
+int evaluate_patterns(uint64_t P, uint64_t O)
+{
+    int edge[EVAL_INSTANCES], corner[EVAL_INSTANCES];
+    int score = 0;
+
+    evaluate_pattern_indices(P, O, edge, corner);
+    for (int k = 0; k < EVAL_INSTANCES; k++)
+        score += edge_table[edge[k]] + corner_table[corner[k]];
+    return score;
+}
+
+/**
+ * Function to load a weights file into weights[] and the pattern
+ * tables. The file has to have been fitted with the eval_coef in use,
+ * since the fit holds the stability and potential mobility terms at
+ * those. Call evaluate_init() afterwards.
+ *
+ * @param path
+ *
+ * @return SUCCESS, or FAILURE if the file is missing, not a weights file
+ *         or fitted with other coefficients
+ */
+int evaluate_load(const char *path)
+{
+    FILE *in = fopen(path, "rb");
+    char magic[4];
+    int32_t version, coef[EVAL_TERMS], square_weights[64];
+
+    if (in == NULL)
+        return FAILURE;
+    if (fread(magic, 1, 4, in) != 4 || memcmp(magic, EVAL_MAGIC, 4) != 0 ||
+        fread(&version, sizeof(version), 1, in) != 1 || version != EVAL_VERSION ||
+        fread(coef, sizeof(int32_t), EVAL_TERMS, in) != EVAL_TERMS ||
+        coef[EVAL_MOBILITY] != eval_coef[EVAL_MOBILITY] || coef[EVAL_STABILITY] != eval_coef[EVAL_STABILITY] ||
+        coef[EVAL_FRONTIER] != eval_coef[EVAL_FRONTIER] ||
+        fread(square_weights, sizeof(int32_t), 64, in) != 64 ||
+        fread(edge_table, sizeof(int16_t), EVAL_EDGESIZE, in) != EVAL_EDGESIZE ||
+        fread(corner_table, sizeof(int16_t), EVAL_CORNERSIZE, in) != EVAL_CORNERSIZE)
+    {
+        fclose(in);
+        eval_patterns = 0;
+        return FAILURE;
+    }
+    fclose(in);
+
+    for (int sq = 0; sq < 64; sq++)
+    {
+        int w = square_weights[sq];
+        weights[PLAYABLE[sq]] = w > EVAL_MAXWEIGHT ? EVAL_MAXWEIGHT : w < -EVAL_MAXWEIGHT ? -EVAL_MAXWEIGHT : w;
+    }
+    eval_patterns = 1;
+    return SUCCESS;
+}
+
+/**
+ * Function to write a weights file from square weights in bit order and
+ * the current pattern tables, fitted with the current eval_coef.
+ *
+ * @param path
+ * @param square_weights
+ *
+ * @return SUCCESS or FAILURE
+ */
+int evaluate_save(const char *path, const int *square_weights)
+{
+    FILE *out = fopen(path, "wb");
+    int32_t version = EVAL_VERSION, coef[EVAL_TERMS], w[64];
+    int ok;
+
+    if (out == NULL)
+        return FAILURE;
+    for (int i = 0; i < EVAL_TERMS; i++)
+        coef[i] = eval_coef[i];
+    for (int sq = 0; sq < 64; sq++)
+        w[sq] = square_weights[sq];
+    ok = fwrite(EVAL_MAGIC, 1, 4, out) == 4 &&
+         fwrite(&version, sizeof(version), 1, out) == 1 &&
+         fwrite(coef, sizeof(int32_t), EVAL_TERMS, out) == EVAL_TERMS &&
+         fwrite(w, sizeof(int32_t), 64, out) == 64 &&
+         fwrite(edge_table, sizeof(int16_t), EVAL_EDGESIZE, out) == EVAL_EDGESIZE &&
+         fwrite(corner_table, sizeof(int16_t), EVAL_CORNERSIZE, out) == EVAL_CORNERSIZE;
+    return fclose(out) == 0 && ok ? SUCCESS : FAILURE;
+}
+
+/**
+ * Function to get how many positions one pass of evaluate_batch()
+ * scores with the kernel in use.
+ *
+ * @return group size
+ */
+int evaluate_batch_width()
+{
+    return bb_kernel == BB_AVX2 ? EVAL_LANES : 1;
+}
+
+/**
+ * Function to score n positions, each from the view of P[i].
+ *
+ * @param P
+ * @param O
+ * @param n       at most EVAL_BATCHSIZE
+ * @param scores
+ */
+void evaluate_batch(const uint64_t *P, const uint64_t *O, int n, int *scores)
+{
+    if (bb_kernel == BB_AVX2)
+        evaluate_batch_avx2(P, O, n, scores);
+    else
+        evaluate_batch_scalar(P, O, n, scores);
+}
+
+void evaluate_batch_scalar(const uint64_t *P, const uint64_t *O, int n, int *scores)
+{
+    for (int i = 0; i < n; i++)
+        scores[i] = evaluate_board(P[i], O[i]);
+}
+
+/*
+    AVX2: lane i holds position i of a group of four. Mobility steps all
+    four positions through each direction together, and the weighted
+    sums count bits per lane with a nibble lookup and _mm256_sad_epu8.
+ */
+#define SHL_RUN(x, seed, mO, s)                                                      \
+    x = _mm256_and_si256(mO, _mm256_slli_epi64(seed, s));                            \
+    for (int k = 0; k < 5; k++)                                                       \
+        x = _mm256_or_si256(x, _mm256_and_si256(mO, _mm256_slli_epi64(x, s)));
+#define SHR_RUN(x, seed, mO, s)                                                      \
+    x = _mm256_and_si256(mO, _mm256_srli_epi64(seed, s));                            \
+    for (int k = 0; k < 5; k++)                                                       \
+        x = _mm256_or_si256(x, _mm256_and_si256(mO, _mm256_srli_epi64(x, s)));
+
+__attribute__((target("avx2"))) static inline __m256i moves4(__m256i P, __m256i O)
+{
+    __m256i mO = _mm256_and_si256(O, _mm256_set1_epi64x(NOT_EDGE));
+    __m256i x, m;
+
+    SHL_RUN(x, P, mO, 1);
+    m = _mm256_slli_epi64(x, 1);
+    SHR_RUN(x, P, mO, 1);
+    m = _mm256_or_si256(m, _mm256_srli_epi64(x, 1));
+    SHL_RUN(x, P, O, 8);
+    m = _mm256_or_si256(m, _mm256_slli_epi64(x, 8));
+    SHR_RUN(x, P, O, 8);
+    m = _mm256_or_si256(m, _mm256_srli_epi64(x, 8));
+    SHL_RUN(x, P, mO, 7);
+    m = _mm256_or_si256(m, _mm256_slli_epi64(x, 7));
+    SHR_RUN(x, P, mO, 7);
+    m = _mm256_or_si256(m, _mm256_srli_epi64(x, 7));
+    SHL_RUN(x, P, mO, 9);
+    m = _mm256_or_si256(m, _mm256_slli_epi64(x, 9));
+    SHR_RUN(x, P, mO, 9);
+    m = _mm256_or_si256(m, _mm256_srli_epi64(x, 9));
+
+    return _mm256_andnot_si256(_mm256_or_si256(P, O), m);
+}
+
+__attribute__((target("avx2"))) static inline __m256i popcount4(__m256i v)
+{
+    const __m256i lut = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                         0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low = _mm256_set1_epi8(0x0f);
+    __m256i lo = _mm256_shuffle_epi8(lut, _mm256_and_si256(v, low));
+    __m256i hi = _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(v, 4), low));
+    return _mm256_sad_epu8(_mm256_add_epi8(lo, hi), _mm256_setzero_si256());
+}
+
+__attribute__((target("avx2"))) static inline __m256i weigh4(__m256i mobility)
+{
+    __m256i sum = _mm256_mul_epi32(popcount4(mobility), _mm256_set1_epi64x(weight_base));
+    for (int k = 0; k < num_planes; k++)
+    {
+        __m256i bits = popcount4(_mm256_and_si256(mobility, _mm256_set1_epi64x(planes[k])));
+        sum = _mm256_add_epi64(sum, _mm256_slli_epi64(bits, k));
+    }
+    return sum;
+}
+
+/*
+    The stability and potential mobility terms of full_lines(),
+    stable_discs() and neighbours() above, four positions at a time. The
+    spreading multiplies become shifts, as AVX2 has no 64 bit multiply,
+    and the stable sets grow until no lane changes.
+ */
+#define AND(a, b) _mm256_and_si256(a, b)
+#define OR(a, b) _mm256_or_si256(a, b)
+#define SHL(a, s) _mm256_slli_epi64(a, s)
+#define SHR(a, s) _mm256_srli_epi64(a, s)
+#define MASK(m) _mm256_set1_epi64x(m)
+
+__attribute__((target("avx2"))) static inline __m256i stable4(__m256i P, __m256i h, __m256i v, __m256i d7, __m256i d9)
+{
+    __m256i stable = _mm256_setzero_si256(), last;
+
+    do
+    {
+        last = stable;
+        stable = AND(AND(P, OR(h, OR(SHL(stable, 1), SHR(stable, 1)))),
+                     AND(OR(v, OR(SHL(stable, 8), SHR(stable, 8))),
+                         AND(OR(d7, OR(SHL(stable, 7), SHR(stable, 7))),
+                             OR(d9, OR(SHL(stable, 9), SHR(stable, 9))))));
+    } while (_mm256_movemask_epi8(_mm256_cmpeq_epi64(stable, last)) != -1);
+    return stable;
+}
+
+__attribute__((target("avx2"))) static inline __m256i neighbours4(__m256i x)
+{
+    __m256i east = _mm256_andnot_si256(MASK(COL_A), SHL(x, 1));
+    __m256i west = _mm256_andnot_si256(MASK(COL_H), SHR(x, 1));
+    __m256i row = OR(x, OR(east, west));
+    return OR(OR(east, west), OR(SHL(row, 8), SHR(row, 8)));
+}
+
+__attribute__((target("avx2"))) static inline __m256i terms4(__m256i P, __m256i O)
+{
+    const __m256i edge = MASK(COL_A | COL_H | ROW_1 | ROW_8);
+    __m256i occupied = OR(P, O), score = _mm256_setzero_si256();
+    __m256i x, y, h, v, d7, d9;
+
+    if (eval_coef[EVAL_STABILITY])
+    {
+        x = AND(occupied, SHR(occupied, 1));
+        x = AND(x, SHR(x, 2));
+        x = AND(AND(x, SHR(x, 4)), MASK(COL_A));
+        x = OR(x, SHL(x, 1));
+        x = OR(x, SHL(x, 2));
+        h = OR(x, SHL(x, 4));
+        x = AND(occupied, SHR(occupied, 8));
+        x = AND(x, SHR(x, 16));
+        x = AND(AND(x, SHR(x, 32)), MASK(ROW_1));
+        x = OR(x, SHL(x, 8));
+        x = OR(x, SHL(x, 16));
+        v = OR(x, SHL(x, 32));
+    }
+    if (eval_coef[EVAL_STABILITY] &&
+        !(_mm256_testz_si256(occupied, MASK(CORNERS)) && _mm256_testz_si256(OR(h, v), OR(h, v))))
+    {
+        x = AND(occupied, OR(SHR(occupied, 9), MASK(ROWS_FROM(7) | COLS_FROM(7))));
+        x = AND(x, OR(SHR(x, 18), MASK(ROWS_FROM(6) | COLS_FROM(6))));
+        x = AND(x, OR(SHR(x, 36), MASK(ROWS_FROM(4) | COLS_FROM(4))));
+        y = AND(occupied, OR(SHL(occupied, 9), MASK(ROWS_BELOW(1) | COLS_BELOW(1))));
+        y = AND(y, OR(SHL(y, 18), MASK(ROWS_BELOW(2) | COLS_BELOW(2))));
+        y = AND(y, OR(SHL(y, 36), MASK(ROWS_BELOW(4) | COLS_BELOW(4))));
+        d9 = OR(AND(x, y), edge);
+        x = AND(occupied, OR(SHR(occupied, 7), MASK(ROWS_FROM(7) | COLS_BELOW(1))));
+        x = AND(x, OR(SHR(x, 14), MASK(ROWS_FROM(6) | COLS_BELOW(2))));
+        x = AND(x, OR(SHR(x, 28), MASK(ROWS_FROM(4) | COLS_BELOW(4))));
+        y = AND(occupied, OR(SHL(occupied, 7), MASK(ROWS_BELOW(1) | COLS_FROM(7))));
+        y = AND(y, OR(SHL(y, 14), MASK(ROWS_BELOW(2) | COLS_FROM(6))));
+        y = AND(y, OR(SHL(y, 28), MASK(ROWS_BELOW(4) | COLS_FROM(4))));
+        d7 = OR(AND(x, y), edge);
+        h = OR(h, MASK(COL_A | COL_H));
+        v = OR(v, MASK(ROW_1 | ROW_8));
+        x = _mm256_sub_epi64(popcount4(stable4(P, h, v, d7, d9)), popcount4(stable4(O, h, v, d7, d9)));
+        score = _mm256_mul_epi32(x, MASK(eval_coef[EVAL_STABILITY]));
+    }
+    if (eval_coef[EVAL_FRONTIER])
+    {
+        __m256i empty = _mm256_xor_si256(occupied, MASK(-1));
+        x = _mm256_sub_epi64(popcount4(AND(empty, neighbours4(O))), popcount4(AND(empty, neighbours4(P))));
+        score = _mm256_add_epi64(score, _mm256_mul_epi32(x, MASK(eval_coef[EVAL_FRONTIER])));
+    }
+    return score;
+}
+
+__attribute__((target("avx2"))) void evaluate_batch_avx2(const uint64_t *P, const uint64_t *O, int n, int *scores)
+{
+    uint64_t p4[EVAL_LANES], o4[EVAL_LANES];
+    int64_t s4[EVAL_LANES];
+
+    for (int i = 0; i < n; i += EVAL_LANES)
+    {
+        int lanes = n - i < EVAL_LANES ? n - i : EVAL_LANES;
+        for (int j = 0; j < EVAL_LANES; j++)
+        {
+            p4[j] = j < lanes ? P[i + j] : 0;
+            o4[j] = j < lanes ? O[i + j] : 0;
+        }
+        __m256i PP = _mm256_loadu_si256((const __m256i *)p4);
+        __m256i OO = _mm256_loadu_si256((const __m256i *)o4);
+        __m256i score = _mm256_sub_epi64(weigh4(moves4(PP, OO)), weigh4(moves4(OO, PP)));
+        score = _mm256_add_epi64(_mm256_mul_epi32(score, MASK(eval_coef[EVAL_MOBILITY])), terms4(PP, OO));
+        _mm256_storeu_si256((__m256i *)s4, score);
+        for (int j = 0; j < lanes; j++)
+            scores[i + j] = clamp_score((int)s4[j] + (eval_patterns ? evaluate_patterns(P[i + j], O[i + j]) : 0));
+    }
+}
@@ -0,0 +1,81 @@
+#ifndef _EVALUATE_H
+#define _EVALUATE_H
+
+#include <stdint.h>
+
+/*
+    Evaluation: weighted mobility, the sum of weights[] over the squares
+    each side could play on, P's minus O's.
+
+    evaluate_batch() scores a set of sibling positions in one call. The
+    AVX2 version puts four positions in the four 64 bit lanes, builds
+    their mobility together and forms the weighted sums from bit planes
+    of the weight table, so a depth-1 node scores all of its children
+    with a handful of vector instructions. evaluate_batch_width() is the
+    number of positions one pass scores, so callers that can cut off
+    early build no more children than that ahead of time.
+ */
+#define EVAL_BATCHSIZE 64
+#define EVAL_LANES 4
+#define EVAL_MAXPLANES 16
+
+/*
+    Positional terms. The score is the sum of each term times its
+    coefficient in eval_coef[], set with --eval m,s,f:
+    EVAL_MOBILITY   the weighted mobility above
+    EVAL_STABILITY  discs that can never be flipped, P's minus O's. A
+                    disc is stable if along each of the four lines
+                    through it the line is full, or one neighbour is the
+                    edge or a stable disc of its own colour
+    EVAL_FRONTIER   potential mobility: empty squares next to the other
+                    side's discs, P's minus O's
+ */
+#define EVAL_TERMS 3
+#define EVAL_MOBILITY 0
+#define EVAL_STABILITY 1
+#define EVAL_FRONTIER 2
+
+/*
+    Tuned evaluation. A weights file written by --train replaces weights[]
+    and adds two pattern tables, each shared by the four symmetric
+    instances of its pattern: the 8 squares of an edge and the 3x3 block
+    at a corner. A pattern index is the base 3 number of its squares
+    (0 empty, 1 P, 2 O), first square lowest. The fit holds the
+    stability and potential mobility terms at eval_coef and scales the
+    square weights by the mobility coefficient, as evaluate_board() does,
+    so the file is the magic, the version, the EVAL_TERMS int32
+    coefficients it was fitted with, 64 int32 square weights in bit
+    order, then the int16 edge and corner tables, in host byte order. It
+    is loaded at startup when --weights names it and the coefficients
+    match --eval; otherwise the built in weights are used.
+ */
+#define EVAL_MAGIC "OTHW"
+#define EVAL_VERSION 2
+#define EVAL_INSTANCES 4
+#define EVAL_EDGE 8
+#define EVAL_EDGESIZE 6561
+#define EVAL_CORNER 9
+#define EVAL_CORNERSIZE 19683
+#define EVAL_MAXWEIGHT 1000
+#define EVAL_MAXSCORE 29000 /* evaluations are clamped inside ALPHA and BETA */
+
+extern int eval_coef[EVAL_TERMS];
+extern int eval_patterns;
+extern int16_t edge_table[EVAL_EDGESIZE];
+extern int16_t corner_table[EVAL_CORNERSIZE];
+
+void evaluate_init();
+int evaluate_board(uint64_t P, uint64_t O);
+int evaluate_terms(uint64_t P, uint64_t O);
+uint64_t evaluate_stable(uint64_t P, uint64_t O);
+int evaluate_parse_coef(const char *text, int *coef);
+int evaluate_patterns(uint64_t P, uint64_t O);
+void evaluate_pattern_indices(uint64_t P, uint64_t O, int *edge, int *corner);
+int evaluate_load(const char *path);
+int evaluate_save(const char *path, const int *square_weights);
+int evaluate_batch_width();
+void evaluate_batch(const uint64_t *P, const uint64_t *O, int n, int *scores);
+void evaluate_batch_scalar(const uint64_t *P, const uint64_t *O, int n, int *scores);
+void evaluate_batch_avx2(const uint64_t *P, const uint64_t *O, int n, int *scores);
+
+#endif
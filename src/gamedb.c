@@ -0,0 +1,557 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <mpi.h>
+#include "comms.h"
+#include "player.h"
+#include "tables.h"
+#include "bitboard.h"
+#include "batch.h"
+#include "mpc.h"
+#include "tune.h"
+#include "gamedb.h"
+
+_Static_assert(sizeof(struct gamedb_header) == GAMEDB_HEADERSIZE, "gamedb header layout changed");
+_Static_assert(sizeof(struct gamedb_entry) == 16, "gamedb index entry layout changed");
+
+const char *gamedb_path = NULL;
+
+static void *map_file(const char *path, size_t *size);
+static void play(uint64_t *black, uint64_t *white, int *player, int move);
+static int compare_entries(const void *a, const void *b);
+static int db_stats(const struct gamedb *db);
+static int db_index(struct gamedb *db, const char *path);
+static int db_query(const struct gamedb *db, const char *text);
+static int db_export(const struct gamedb *db, const char *path);
+
+/**
+ * Function to start recording a game.
+ *
+ * @param g
+ * @param black   starting position
+ * @param white
+ * @param player  to move first
+ * @param source  GAMEDB_SELFPLAY or GAMEDB_MATCH
+ */
+void gamedb_start(struct gamedb_game *g, uint64_t black, uint64_t white, int player, int source)
+{
+    memset(g, 0, sizeof(*g));
+    g->h.magic = GAMEDB_MAGIC;
+    g->h.black = g->black = black;
+    g->h.white = g->white = white;
+    g->h.player = g->to_move = player;
+    g->h.source = source;
+    g->h.engine = EMPTY;
+    g->h.search = search_mode;
+    g->h.mpc = mpc_t;
+    g->h.ranks = size;
+    for (int i = 0; i < EVAL_TERMS; i++)
+        g->h.coef[0][i] = g->h.coef[1][i] = eval_coef[i];
+}
+
+/**
+ * Function to add a move to a game. A side that was skipped gets its
+ * pass written first, so callers that never hear of a pass can leave
+ * it out.
+ *
+ * @param g
+ * @param colour  side that moved
+ * @param sq      bit index of the square, -1 to pass
+ */
+void gamedb_move(struct gamedb_game *g, int colour, int sq)
+{
+    if (colour != g->to_move && g->h.moves < GAMEDB_MAXMOVES)
+    {
+        g->move[g->h.moves++] = GAMEDB_PASS;
+        play(&g->black, &g->white, &g->to_move, GAMEDB_PASS);
+    }
+    if (g->h.moves < GAMEDB_MAXMOVES)
+        g->move[g->h.moves++] = sq < 0 ? GAMEDB_PASS : sq;
+    play(&g->black, &g->white, &g->to_move, sq < 0 ? GAMEDB_PASS : sq);
+}
+
+/**
+ * Function to append a finished game to the database, creating it if
+ * need be. The record is written with one write() under an exclusive
+ * lock, so concurrent writers never interleave.
+ *
+ * @param path
+ * @param g
+ *
+ * @return SUCCESS or FAILURE
+ */
+int gamedb_append(const char *path, struct gamedb_game *g)
+{
+    unsigned char record[GAMEDB_HEADERSIZE + GAMEDB_MAXMOVES];
+    int fd, result = SUCCESS;
+
+    g->h.result = __builtin_popcountll(g->black) - __builtin_popcountll(g->white);
+    g->h.date = time(NULL);
+    g->h.length = GAMEDB_HEADERSIZE + g->h.moves;
+    memcpy(record, &g->h, GAMEDB_HEADERSIZE);
+    memcpy(record + GAMEDB_HEADERSIZE, g->move, g->h.moves);
+
+    fd = open(path, O_WRONLY | O_APPEND | O_CREAT, 0644);
+    if (fd < 0)
+    {
+        fprintf(stderr, "gamedb: cannot open %s\n", path);
+        return FAILURE;
+    }
+    flock(fd, LOCK_EX);
+    if (write(fd, record, g->h.length) != g->h.length)
+    {
+        fprintf(stderr, "gamedb: cannot append to %s\n", path);
+        result = FAILURE;
+    }
+    flock(fd, LOCK_UN);
+    close(fd);
+    return result;
+}
+
+/**
+ * Function to map a database and its index, if it has a current one,
+ * for reading.
+ *
+ * @param db
+ * @param path
+ *
+ * @return SUCCESS, or FAILURE if the database cannot be read
+ */
+int gamedb_open(struct gamedb *db, const char *path)
+{
+    char idx_path[4096];
+    const struct gamedb_index *index;
+
+    memset(db, 0, sizeof(*db));
+    db->data = map_file(path, &db->size);
+    if (db->data == NULL && db->size != 0)
+        return FAILURE;
+
+    snprintf(idx_path, sizeof(idx_path), "%s.idx", path);
+    index = map_file(idx_path, &db->index_size);
+    if (index == NULL)
+        return SUCCESS;
+    if (db->index_size < sizeof(*index) || index->magic != GAMEDB_IDXMAGIC || index->covered > db->size ||
+        db->index_size != sizeof(*index) + index->games * sizeof(uint64_t) +
+                              index->entries * sizeof(struct gamedb_entry))
+    {
+        fprintf(stderr, "gamedb: %s does not match the database, ignoring it\n", idx_path);
+        munmap((void *)index, db->index_size);
+        return SUCCESS;
+    }
+    db->index = index;
+    db->offsets = (const uint64_t *)(index + 1);
+    db->entries = (const struct gamedb_entry *)(db->offsets + index->games);
+    return SUCCESS;
+}
+
+/**
+ * Function to step through the games in file order, starting from
+ * offset 0. A torn record at the end, from a writer that was killed,
+ * ends the walk.
+ *
+ * @param db
+ * @param offset  of the next record, advanced past it
+ *
+ * @return the record's header, NULL after the last one
+ */
+const struct gamedb_header *gamedb_next(const struct gamedb *db, size_t *offset)
+{
+    const struct gamedb_header *h;
+
+    if (*offset + GAMEDB_HEADERSIZE > db->size)
+        return NULL;
+    h = (const struct gamedb_header *)(db->data + *offset);
+    if (h->magic != GAMEDB_MAGIC || h->length < GAMEDB_HEADERSIZE + h->moves || *offset + h->length > db->size)
+    {
+        fprintf(stderr, "gamedb: bad record at byte %zu, stopping there\n", *offset);
+        return NULL;
+    }
+    *offset += h->length;
+    return h;
+}
+
+void gamedb_close(struct gamedb *db)
+{
+    if (db->data != NULL)
+        munmap((void *)db->data, db->size);
+    if (db->index != NULL)
+        munmap((void *)db->index, db->index_size);
+    memset(db, 0, sizeof(*db));
+}
+
+/**
+ * Function to hash a position for the index. It depends on nothing but
+ * the position, so an index stays valid across builds.
+ *
+ * @param black
+ * @param white
+ * @param player  to move
+ *
+ * @return key
+ */
+uint64_t gamedb_key(uint64_t black, uint64_t white, int player)
+{
+    uint64_t h = black * 0x9e3779b97f4a7c15ULL ^ (white * 0xc2b2ae3d27d4eb4fULL >> 7) ^ player;
+
+    h ^= h >> 31;
+    h *= 0xbf58476d1ce4e5b9ULL;
+    h ^= h >> 27;
+    h *= 0x94d049bb133111ebULL;
+    return h ^ (h >> 31);
+}
+
+/**
+ * Entry point for the database tools, only rank 0 does any work.
+ *
+ * Usage: main --gamedb <db> stats | index | query <position> | export <labels.bin>
+ *
+ * @param argc
+ * @param argv
+ *
+ * @return SUCCESS or FAILURE
+ */
+int gamedb_main(int argc, char *argv[])
+{
+    struct gamedb db;
+    int result;
+
+    if (rank != 0)
+        return SUCCESS;
+    if (gamedb_open(&db, argv[2]) == FAILURE)
+    {
+        fprintf(stderr, "gamedb: cannot read %s\n", argv[2]);
+        return FAILURE;
+    }
+
+    if (strcmp(argv[3], "stats") == 0)
+        result = db_stats(&db);
+    else if (strcmp(argv[3], "index") == 0)
+        result = db_index(&db, argv[2]);
+    else if (strcmp(argv[3], "query") == 0 && argc >= 5)
+        result = db_query(&db, argv[4]);
+    else if (strcmp(argv[3], "export") == 0 && argc >= 5)
+        result = db_export(&db, argv[4]);
+    else
+    {
+        fprintf(stderr, "gamedb: expected stats, index, query <position> or export <file>\n");
+        result = FAILURE;
+    }
+    gamedb_close(&db);
+    return result;
+}
+
+/*
+    Maps a whole file read only. Returns NULL with size 0 for a missing
+    or empty file, NULL with the size set if it cannot be mapped.
+ */
+static void *map_file(const char *path, size_t *size)
+{
+    struct stat st;
+    void *p;
+    int fd = open(path, O_RDONLY);
+
+    *size = 0;
+    if (fd < 0)
+        return NULL;
+    if (fstat(fd, &st) < 0 || st.st_size == 0)
+    {
+        close(fd);
+        return NULL;
+    }
+    *size = st.st_size;
+    p = mmap(NULL, *size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    return p == MAP_FAILED ? NULL : p;
+}
+
+/*
+    Plays a recorded move, GAMEDB_PASS for a pass
+ */
+static void play(uint64_t *black, uint64_t *white, int *player, int move)
+{
+    uint64_t *P = *player == BLACK ? black : white;
+    uint64_t *O = *player == BLACK ? white : black;
+
+    if (move != GAMEDB_PASS)
+    {
+        uint64_t flips = bb_flips(*P, *O, move);
+        *P ^= flips | (1ULL << move);
+        *O ^= flips;
+    }
+    *player = OPPONENT[*player];
+}
+
+/* key, then game and ply, so equal positions list in file order */
+static int compare_entries(const void *a, const void *b)
+{
+    const struct gamedb_entry *x = a, *y = b;
+
+    if (x->key != y->key)
+        return x->key < y->key ? -1 : 1;
+    if (x->game != y->game)
+        return x->game < y->game ? -1 : 1;
+    return (int)x->ply - (int)y->ply;
+}
+
+static int db_stats(const struct gamedb *db)
+{
+    const struct gamedb_header *h;
+    size_t offset = 0;
+    long games = 0, sources[2] = {0, 0}, results[3] = {0, 0, 0}, moves = 0;
+    double seconds = 0;
+
+    while ((h = gamedb_next(db, &offset)) != NULL)
+    {
+        games++;
+        sources[h->source == GAMEDB_MATCH]++;
+        results[h->result > 0 ? 0 : h->result == 0 ? 1 : 2]++;
+        moves += h->moves;
+        seconds += h->seconds[0] + h->seconds[1];
+    }
+    printf("gamedb: %ld games in %zu bytes, %ld self-play and %ld matches\n", games, db->size, sources[0],
+           sources[1]);
+    if (games > 0)
+        printf("black %ld wins %ld draws %ld losses, %.1f moves and %.2fs thinking a game\n", results[0],
+               results[1], results[2], (double)moves / games, seconds / games);
+    if (db->index == NULL)
+        printf("no index\n");
+    else
+        printf("index: %u games, %llu positions%s\n", db->index->games, (unsigned long long)db->index->entries,
+               db->index->covered < offset ? ", games have been added since" : "");
+    return SUCCESS;
+}
+
+/**
+ * Function to bring the index up to date. Only the games appended since
+ * it was last built are replayed; their positions are sorted and merged
+ * with the existing entries into a new file, which then replaces the old
+ * index, so a reader never sees a half written one.
+ *
+ * @param db
+ * @param path  of the database
+ *
+ * @return SUCCESS or FAILURE
+ */
+static int db_index(struct gamedb *db, const char *path)
+{
+    char idx_path[4096], tmp_path[4096];
+    struct gamedb_index index = {GAMEDB_IDXMAGIC, 0, 0, 0};
+    const struct gamedb_header *h;
+    struct gamedb_entry *added = NULL;
+    uint64_t *offsets = NULL;
+    size_t offset, n_added = 0, cap_added = 0, n_games = 0, cap_games = 0;
+    FILE *out;
+
+    snprintf(idx_path, sizeof(idx_path), "%s.idx", path);
+    snprintf(tmp_path, sizeof(tmp_path), "%s.idx.tmp", path);
+    offset = db->index != NULL ? db->index->covered : 0;
+    index.games = db->index != NULL ? db->index->games : 0;
+
+    for (size_t start = offset; (h = gamedb_next(db, &offset)) != NULL; start = offset)
+    {
+        const uint8_t *move = (const uint8_t *)h + GAMEDB_HEADERSIZE;
+        uint64_t black = h->black, white = h->white;
+        int player = h->player;
+
+        if (n_games == cap_games)
+            offsets = realloc(offsets, (cap_games = cap_games * 2 + 1024) * sizeof(uint64_t));
+        if (n_added + h->moves + 1 > cap_added)
+            added = realloc(added, (cap_added = cap_added * 2 + h->moves + 65536) * sizeof(struct gamedb_entry));
+        if (offsets == NULL || added == NULL)
+        {
+            fprintf(stderr, "gamedb: out of memory indexing game %zu\n", index.games + n_games);
+            return FAILURE;
+        }
+        offsets[n_games] = start;
+        for (int ply = 0; ply <= h->moves; ply++)
+        {
+            struct gamedb_entry *e = &added[n_added++];
+            e->key = gamedb_key(black, white, player);
+            e->game = index.games + n_games;
+            e->ply = ply;
+            e->move = ply < h->moves ? move[ply] : 0xffff;
+            if (ply < h->moves)
+                play(&black, &white, &player, move[ply]);
+        }
+        n_games++;
+    }
+    qsort(added, n_added, sizeof(struct gamedb_entry), compare_entries);
+
+    out = fopen(tmp_path, "wb");
+    if (out == NULL)
+    {
+        fprintf(stderr, "gamedb: cannot write %s\n", tmp_path);
+        free(offsets);
+        free(added);
+        return FAILURE;
+    }
+    index.games += n_games;
+    index.entries = (db->index != NULL ? db->index->entries : 0) + n_added;
+    index.covered = offset;
+    fwrite(&index, sizeof(index), 1, out);
+    if (db->index != NULL)
+        fwrite(db->offsets, sizeof(uint64_t), db->index->games, out);
+    fwrite(offsets, sizeof(uint64_t), n_games, out);
+
+    /* merge the old entries, mapped, with the new ones */
+    size_t i = 0, j = 0, old = db->index != NULL ? db->index->entries : 0;
+    while (i < old || j < n_added)
+    {
+        if (j == n_added || (i < old && compare_entries(&db->entries[i], &added[j]) <= 0))
+            fwrite(&db->entries[i++], sizeof(struct gamedb_entry), 1, out);
+        else
+            fwrite(&added[j++], sizeof(struct gamedb_entry), 1, out);
+    }
+    free(offsets);
+    free(added);
+    if (fclose(out) != 0 || rename(tmp_path, idx_path) != 0)
+    {
+        fprintf(stderr, "gamedb: cannot write %s\n", idx_path);
+        return FAILURE;
+    }
+    printf("gamedb: indexed %zu new games, %u games and %llu positions in all\n", n_games, index.games,
+           (unsigned long long)index.entries);
+    return SUCCESS;
+}
+
+/**
+ * Function to list the moves played from a position: a binary search of
+ * the index finds its entries, and each carries the move played and the
+ * game, whose header has the result.
+ *
+ * @param db
+ * @param text  position, written like a --batch line
+ *
+ * @return SUCCESS or FAILURE
+ */
+static int db_query(const struct gamedb *db, const char *text)
+{
+    struct batch_position pos;
+    long count[GAMEDB_PASS + 2] = {0};
+    double sum[GAMEDB_PASS + 2] = {0}, wins[GAMEDB_PASS + 2] = {0};
+    size_t lo = 0, hi, n = 0;
+    uint64_t key;
+
+    if (batch_parse_position(text, &pos) == FAILURE)
+    {
+        fprintf(stderr, "gamedb: bad position %s\n", text);
+        return FAILURE;
+    }
+    if (db->index == NULL)
+    {
+        fprintf(stderr, "gamedb: no index, run --gamedb <db> index first\n");
+        return FAILURE;
+    }
+    if (db->index->covered < db->size)
+        fprintf(stderr, "gamedb: games have been added since the index was built\n");
+
+    key = gamedb_key(pos.black, pos.white, pos.player);
+    hi = db->index->entries;
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if (db->entries[mid].key < key)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    for (; lo < db->index->entries && db->entries[lo].key == key; lo++, n++)
+    {
+        const struct gamedb_entry *e = &db->entries[lo];
+        const struct gamedb_header *h = (const struct gamedb_header *)(db->data + db->offsets[e->game]);
+        int move = e->move == 0xffff ? GAMEDB_PASS + 1 : e->move;
+        int result = pos.player == BLACK ? h->result : -h->result;
+
+        count[move]++;
+        sum[move] += result;
+        wins[move] += result > 0 ? 1 : result == 0 ? 0.5 : 0;
+    }
+
+    printf("gamedb: position seen %zu times\n", n);
+    if (n == 0)
+        return SUCCESS;
+    printf(" move  games   score    mean\n");
+    while (1)
+    {
+        int pick = -1;
+        for (int m = 0; m < GAMEDB_PASS + 2; m++)
+        {
+            if (count[m] > 0 && (pick == -1 || count[m] > count[pick]))
+                pick = m;
+        }
+        if (pick == -1)
+            break;
+        if (pick == GAMEDB_PASS + 1)
+            printf("  end");
+        else if (pick == GAMEDB_PASS)
+            printf(" pass");
+        else
+            printf("   %d%d", pick / 8, pick % 8);
+        printf("  %5ld  %5.1f%%  %+6.2f\n", count[pick], 100 * wins[pick] / count[pick], sum[pick] / count[pick]);
+        count[pick] = 0;
+    }
+    return SUCCESS;
+}
+
+/**
+ * Function to write every position a move was played from, passes
+ * aside, as --train binary records labelled with the game's final disc
+ * difference from the side to move's view.
+ *
+ * @param db
+ * @param path
+ *
+ * @return SUCCESS or FAILURE
+ */
+static int db_export(const struct gamedb *db, const char *path)
+{
+    const struct gamedb_header *h;
+    unsigned char rec[TUNE_RECORDSIZE];
+    size_t offset = 0;
+    long games = 0, positions = 0;
+    FILE *out = fopen(path, "wb");
+
+    if (out == NULL)
+    {
+        fprintf(stderr, "gamedb: cannot write %s\n", path);
+        return FAILURE;
+    }
+    while ((h = gamedb_next(db, &offset)) != NULL)
+    {
+        const uint8_t *move = (const uint8_t *)h + GAMEDB_HEADERSIZE;
+        uint64_t black = h->black, white = h->white;
+        int player = h->player;
+
+        for (int ply = 0; ply < h->moves; ply++)
+        {
+            if (move[ply] != GAMEDB_PASS)
+            {
+                for (int i = 0; i < 8; i++)
+                {
+                    rec[i] = black >> (8 * i);
+                    rec[8 + i] = white >> (8 * i);
+                }
+                rec[16] = player;
+                rec[17] = (unsigned char)(player == BLACK ? h->result : -h->result);
+                fwrite(rec, 1, TUNE_RECORDSIZE, out);
+                positions++;
+            }
+            play(&black, &white, &player, move[ply]);
+        }
+        games++;
+    }
+    if (fclose(out) != 0)
+    {
+        fprintf(stderr, "gamedb: cannot write %s\n", path);
+        return FAILURE;
+    }
+    printf("gamedb: %ld positions from %ld games written to %s\n", positions, games, path);
+    return SUCCESS;
+}
@@ -0,0 +1,115 @@
+#ifndef _GAMEDB_H
+#define _GAMEDB_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "evaluate.h"
+
+/*
+    Game database: an append-only file of binary game records, written
+    by self-play, the game loop and the server when --record <db> is
+    given. A
+    record is a GAMEDB_HEADERSIZE byte header (result, starting
+    position, configuration and timings) followed by one byte per move,
+    the square's bit index (0 = a1) or GAMEDB_PASS. Passes are written
+    out, so a game replays without move generation deciding who is to
+    move. Each record goes out in a single write under an exclusive
+    lock, so any number of ranks and runs can append to one file.
+
+    The index (<db>.idx) maps the position before every move to the game
+    and ply it occurs at, sorted by gamedb_key() so a query is a binary
+    search. It is built and extended by --gamedb <db> index: games
+    appended since the last run are merged in, the rest is not read.
+    Both files are read through mmap and used in place, so the record
+    layout below is the file layout (little endian, as written on every
+    machine this runs on).
+        main --gamedb <db> stats
+        main --gamedb <db> index
+        main --gamedb <db> query <position>
+        main --gamedb <db> export <labels.bin>
+    A query position is written like a --batch line; it prints the moves
+    played from it with their counts and mean results. export writes
+    every position with the game's final result as --train binary input.
+ */
+#define GAMEDB_MAGIC 0x4244474fu     /* "OGDB" */
+#define GAMEDB_IDXMAGIC 0x5844494fu  /* "OIDX" */
+#define GAMEDB_HEADERSIZE 80
+#define GAMEDB_MAXMOVES 128
+#define GAMEDB_PASS 64
+
+/* source of a game */
+#define GAMEDB_SELFPLAY 0
+#define GAMEDB_MATCH 1
+
+struct gamedb_header
+{
+    uint32_t magic;
+    uint16_t length;  /* bytes in the record, header and moves */
+    uint8_t moves;
+    int8_t result;    /* final disc difference, black minus white */
+    uint64_t black;   /* starting position */
+    uint64_t white;
+    uint64_t nodes;   /* searched by the engine, both sides in self-play */
+    int64_t date;     /* unix time at the end of the game */
+    float seconds[2]; /* thinking time, black then white */
+    float mpc;        /* mpc_t */
+    uint32_t time_ms; /* a move in self-play, the game loop's time limit in a match, 0 from --serve */
+    int16_t coef[2][EVAL_TERMS]; /* evaluation coefficients, black then white */
+    uint32_t opening; /* self-play opening number */
+    uint16_t ranks;
+    uint8_t depth[2]; /* mean depth reached in self-play, the depth limit in a match */
+    uint8_t player;   /* to move first */
+    uint8_t source;   /* GAMEDB_SELFPLAY or GAMEDB_MATCH */
+    uint8_t engine;   /* colour the engine played in a match, EMPTY in self-play */
+    uint8_t search;   /* search_mode */
+};
+
+/* a game being played, appended by gamedb_append() when it ends */
+struct gamedb_game
+{
+    struct gamedb_header h;
+    uint8_t move[GAMEDB_MAXMOVES];
+    uint64_t black, white; /* current position */
+    int to_move;
+};
+
+struct gamedb_entry
+{
+    uint64_t key;
+    uint32_t game;
+    uint16_t ply;
+    uint16_t move; /* played from the position, GAMEDB_PASS or 0xffff at the end */
+};
+
+struct gamedb_index
+{
+    uint32_t magic;
+    uint32_t games;
+    uint64_t entries;
+    uint64_t covered;   /* bytes of the database indexed */
+    /* followed by uint64_t offsets[games] and struct gamedb_entry entries[entries] */
+};
+
+/* a database mapped for reading */
+struct gamedb
+{
+    const unsigned char *data;
+    size_t size;
+    const struct gamedb_index *index; /* NULL without an index */
+    size_t index_size;
+    const uint64_t *offsets;
+    const struct gamedb_entry *entries;
+};
+
+extern const char *gamedb_path;
+
+void gamedb_start(struct gamedb_game *g, uint64_t black, uint64_t white, int player, int source);
+void gamedb_move(struct gamedb_game *g, int colour, int sq);
+int gamedb_append(const char *path, struct gamedb_game *g);
+int gamedb_open(struct gamedb *db, const char *path);
+const struct gamedb_header *gamedb_next(const struct gamedb *db, size_t *offset);
+void gamedb_close(struct gamedb *db);
+uint64_t gamedb_key(uint64_t black, uint64_t white, int player);
+int gamedb_main(int argc, char *argv[]);
+
+#endif
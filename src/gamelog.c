@@ -0,0 +1,245 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "comms.h"
+#include "gamelog.h"
+
+int gamelog_verbose = 0;
+
+static const char log_piecenames[4] = {'.', 'b', 'w', '?'};
+
+static void *gamelog_writer(void *arg);
+static void gamelog_push(struct gamelog *log, struct gamelog_record *rec);
+static void gamelog_format(FILE *fp, struct gamelog_record *rec);
+
+/**
+ * Function to open a log file and start its writer thread.
+ *
+ * @param log
+ * @param path
+ *
+ * @return SUCCESS or FAILURE
+ */
+int gamelog_open(struct gamelog *log, const char *path)
+{
+    log->fp = fopen(path, "w");
+    if (log->fp == NULL)
+        return FAILURE;
+    fprintf(log->fp, "# ply colour move score nodes seconds black white\n");
+
+    log->head = 0;
+    log->tail = 0;
+    log->stop = 0;
+    pthread_mutex_init(&log->lock, NULL);
+    pthread_cond_init(&log->not_empty, NULL);
+    pthread_cond_init(&log->not_full, NULL);
+    if (pthread_create(&log->writer, NULL, gamelog_writer, log) != 0)
+    {
+        fclose(log->fp);
+        log->fp = NULL;
+        return FAILURE;
+    }
+    return SUCCESS;
+}
+
+/**
+ * Function to queue a move record. The disc counts are taken from the
+ * board after the move and, at the verbose level, the board itself.
+ *
+ * @param log
+ * @param ply
+ * @param colour
+ * @param move
+ * @param score
+ * @param nodes
+ * @param seconds
+ * @param board
+ */
+void gamelog_move(struct gamelog *log, int ply, int colour, int move, int score,
+                  long long nodes, double seconds, int *board)
+{
+    struct gamelog_record rec;
+    if (log->fp == NULL)
+        return;
+
+    rec.type = GAMELOG_MOVE;
+    rec.ply = ply;
+    rec.colour = colour;
+    rec.move = move;
+    rec.score = score;
+    rec.nodes = nodes;
+    rec.seconds = seconds;
+    rec.black = 0;
+    rec.white = 0;
+    for (int i = 11; i <= 88; i++)
+    {
+        if (board[i] == BLACK)
+            rec.black++;
+        else if (board[i] == WHITE)
+            rec.white++;
+    }
+    gamelog_push(log, &rec);
+    gamelog_board(log, board);
+}
+
+/**
+ * Function to queue a full board dump, only at the verbose level.
+ *
+ * @param log
+ * @param board
+ */
+void gamelog_board(struct gamelog *log, int *board)
+{
+    struct gamelog_record rec;
+    if (log->fp == NULL || !gamelog_verbose)
+        return;
+
+    rec.type = GAMELOG_BOARD;
+    rec.black = 0;
+    rec.white = 0;
+    for (int row = 1; row <= 8; row++)
+    {
+        for (int col = 1; col <= 8; col++)
+        {
+            int piece = board[col + 10 * row];
+            rec.text[(row - 1) * 8 + col - 1] = piece;
+            if (piece == BLACK)
+                rec.black++;
+            else if (piece == WHITE)
+                rec.white++;
+        }
+    }
+    gamelog_push(log, &rec);
+}
+
+/**
+ * Function to queue a one line message.
+ *
+ * @param log
+ * @param text
+ */
+void gamelog_message(struct gamelog *log, const char *text)
+{
+    struct gamelog_record rec;
+    if (log->fp == NULL)
+        return;
+
+    rec.type = GAMELOG_TEXT;
+    strncpy(rec.text, text, GAMELOG_TEXTSIZE - 1);
+    rec.text[GAMELOG_TEXTSIZE - 1] = 0;
+    gamelog_push(log, &rec);
+}
+
+/**
+ * Function to stop the writer thread once it has written every queued
+ * record, then flush and close the file.
+ *
+ * @param log
+ */
+void gamelog_close(struct gamelog *log)
+{
+    if (log->fp == NULL)
+        return;
+
+    pthread_mutex_lock(&log->lock);
+    log->stop = 1;
+    pthread_cond_signal(&log->not_empty);
+    pthread_mutex_unlock(&log->lock);
+    pthread_join(log->writer, NULL);
+
+    fclose(log->fp);
+    log->fp = NULL;
+    pthread_mutex_destroy(&log->lock);
+    pthread_cond_destroy(&log->not_empty);
+    pthread_cond_destroy(&log->not_full);
+}
+
+/**
+ * Function to add a record to the ring. Only blocks if the writer has
+ * fallen a full ring behind.
+ *
+ * @param log
+ * @param rec
+ */
+static void gamelog_push(struct gamelog *log, struct gamelog_record *rec)
+{
+    pthread_mutex_lock(&log->lock);
+    while (log->tail - log->head == GAMELOG_RING)
+        pthread_cond_wait(&log->not_full, &log->lock);
+    log->ring[log->tail % GAMELOG_RING] = *rec;
+    log->tail++;
+    pthread_cond_signal(&log->not_empty);
+    pthread_mutex_unlock(&log->lock);
+}
+
+/**
+ * Writer thread: takes whatever is queued and formats it outside the
+ * lock. The file is only flushed when the log is closed.
+ *
+ * @param arg  the gamelog
+ */
+static void *gamelog_writer(void *arg)
+{
+    struct gamelog *log = arg;
+    struct gamelog_record rec;
+
+    pthread_mutex_lock(&log->lock);
+    while (1)
+    {
+        while (log->head == log->tail && !log->stop)
+            pthread_cond_wait(&log->not_empty, &log->lock);
+        if (log->head == log->tail)
+            break;
+
+        rec = log->ring[log->head % GAMELOG_RING];
+        log->head++;
+        pthread_cond_signal(&log->not_full);
+        pthread_mutex_unlock(&log->lock);
+
+        gamelog_format(log->fp, &rec);
+
+        pthread_mutex_lock(&log->lock);
+    }
+    pthread_mutex_unlock(&log->lock);
+    fflush(log->fp);
+    return NULL;
+}
+
+/**
+ * Function to write a single record.
+ *
+ * @param fp
+ * @param rec
+ */
+static void gamelog_format(FILE *fp, struct gamelog_record *rec)
+{
+    int row, col;
+
+    switch (rec->type)
+    {
+    case GAMELOG_MOVE:
+        if (rec->move < 0)
+            fprintf(fp, "%d %c pass", rec->ply, log_piecenames[rec->colour]);
+        else
+            fprintf(fp, "%d %c %d%d", rec->ply, log_piecenames[rec->colour],
+                    rec->move / 10 - 1, rec->move % 10 - 1);
+        fprintf(fp, " %d %lld %.6f %d %d\n", rec->score, rec->nodes, rec->seconds,
+                rec->black, rec->white);
+        break;
+    case GAMELOG_BOARD:
+        fprintf(fp, "   1 2 3 4 5 6 7 8 [%c=%d %c=%d]\n",
+                log_piecenames[BLACK], rec->black, log_piecenames[WHITE], rec->white);
+        for (row = 0; row < 8; row++)
+        {
+            fprintf(fp, "%d  ", row + 1);
+            for (col = 0; col < 8; col++)
+                fprintf(fp, "%c ", log_piecenames[(int)rec->text[row * 8 + col]]);
+            fprintf(fp, "\n");
+        }
+        break;
+    default:
+        fprintf(fp, "# %s\n", rec->text);
+        break;
+    }
+}
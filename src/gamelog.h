@@ -0,0 +1,58 @@
+#ifndef _GAMELOG_H
+#define _GAMELOG_H
+
+#include <stdio.h>
+#include <pthread.h>
+
+/*
+    Game record logger. Callers queue small fixed size records in a ring
+    buffer and a background writer thread formats them to the file, so
+    no file I/O happens on the search path. Everything still queued is
+    written and flushed by gamelog_close() at the end of the game.
+
+    Each move becomes one line:
+        ply colour move score nodes seconds black white
+    Full board dumps are only queued when gamelog_verbose is set.
+ */
+#define GAMELOG_RING 256
+#define GAMELOG_TEXTSIZE 64
+
+#define GAMELOG_MOVE 0
+#define GAMELOG_BOARD 1
+#define GAMELOG_TEXT 2
+
+struct gamelog_record
+{
+    int type;
+    int ply;
+    int colour;
+    int move;   /* board location, -1 for a pass */
+    int score;
+    int black;  /* disc counts after the move */
+    int white;
+    long long nodes;
+    double seconds;
+    char text[GAMELOG_TEXTSIZE]; /* board squares or message */
+};
+
+struct gamelog
+{
+    FILE *fp;
+    struct gamelog_record ring[GAMELOG_RING];
+    int head, tail;
+    int stop;
+    pthread_t writer;
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty, not_full;
+};
+
+extern int gamelog_verbose;
+
+int gamelog_open(struct gamelog *log, const char *path);
+void gamelog_move(struct gamelog *log, int ply, int colour, int move, int score,
+                  long long nodes, double seconds, int *board);
+void gamelog_board(struct gamelog *log, int *board);
+void gamelog_message(struct gamelog *log, const char *text);
+void gamelog_close(struct gamelog *log);
+
+#endif
@@ -0,0 +1,592 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <mpi.h>
+#include "comms.h"
+#include "player.h"
+#include "tables.h"
+#include "bitboard.h"
+#include "mpc.h"
+#include "tt.h"
+#include "lazy.h"
+#include "journal.h"
+
+#define JOURNAL_CHUNK 4096
+#define JOURNAL_MAXROOT 64
+
+int journal_on = 0;
+
+static const char *journal_path;
+static struct journal_event *events;
+static long recorded, capacity;
+static int searches;
+static int snapshot_used;
+static double origin;
+
+/* one root move of a replayed split search */
+struct replay_root
+{
+    int square;
+    int score;
+    long long nodes; /* the worker's count after it */
+    int rec_score;
+    long long rec_nodes;
+};
+
+/* one worker's part of one search, replayed and as recorded */
+struct replay_result
+{
+    int searched; /* 1 replayed, -1 not replayable, 0 not this worker's */
+    int mode;
+    int move, score, complete, depth;
+    long long nodes;
+    double seconds;
+    int rec_move, rec_score, rec_complete;
+    long long rec_nodes;
+    double rec_seconds;
+    int shares_in, shares_out;
+    int roots;
+    struct replay_root root[JOURNAL_MAXROOT];
+};
+
+static struct journal_event *add(int type);
+static void replay_worker(const struct journal_event *e, long n, int limit, struct replay_result *res);
+static void report(const struct journal_header *h, const struct journal_event *main_events, long n,
+                   struct replay_result *res, int limit, int target);
+static int same(const struct replay_result *r);
+static void write_square(int sq);
+
+/**
+ * Function to start recording, called on every rank with the same path.
+ * Nothing happens with a NULL path.
+ *
+ * @param path      where journal_finish() writes the journal
+ * @param snapshot  1 if a snapshot table is in use
+ */
+void journal_init(const char *path, int snapshot)
+{
+    if (path == NULL)
+        return;
+    capacity = JOURNAL_CHUNK;
+    events = malloc(capacity * sizeof(struct journal_event));
+    if (events == NULL)
+    {
+        fprintf(stderr, "journal: cannot allocate the event log\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    journal_path = path;
+    snapshot_used = snapshot;
+    MPI_Barrier(MPI_COMM_WORLD);
+    origin = MPI_Wtime();
+    journal_on = 1;
+}
+
+/**
+ * Function to record the start of a search on the global board, with
+ * my_colour to move. Every rank numbers the searches it is given from 1,
+ * so the numbers agree between rank 0 and the workers.
+ *
+ * @param helper  lazy SMP helper number, 0 otherwise
+ */
+void journal_search(int helper)
+{
+    struct journal_event *e;
+
+    if (!journal_on)
+        return;
+    searches++;
+    if ((e = add(JOURNAL_SEARCH)) == NULL)
+        return;
+    bb_from_board(board, my_colour, &e->P, &e->O);
+    e->a = my_colour;
+    e->b = search_mode;
+    e->c = search_depth;
+    e->d = helper;
+}
+
+void journal_record(int type, int a, int b, int c, int d)
+{
+    struct journal_event *e;
+
+    if (!journal_on || (e = add(type)) == NULL)
+        return;
+    e->a = a;
+    e->b = b;
+    e->c = c;
+    e->d = d;
+}
+
+/**
+ * Function to record a worker's result.
+ *
+ * @param move      board location, -1 for none
+ * @param score
+ * @param complete  0 if the search was stopped
+ * @param depth
+ */
+void journal_result(int move, int score, int complete, int depth)
+{
+    journal_record(JOURNAL_RESULT, move > -1 ? BITSQUARE[move] : -1, score, complete, depth);
+}
+
+void journal_arrival(int from)
+{
+    journal_record(JOURNAL_ARRIVAL, from, 0, 0, 0);
+}
+
+/**
+ * Function to gather every rank's events on rank 0 and write the
+ * journal. Collective; does nothing unless recording was started.
+ */
+void journal_finish()
+{
+    int bytes = recorded * sizeof(struct journal_event), *counts = NULL, *displs = NULL;
+    char *all = NULL;
+
+    if (journal_path == NULL)
+        return;
+    journal_on = 0;
+    if (rank == 0)
+    {
+        counts = malloc(size * sizeof(int));
+        displs = malloc(size * sizeof(int));
+    }
+    MPI_Gather(&bytes, 1, MPI_INT, counts, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    if (rank == 0)
+    {
+        long total = 0;
+        for (int i = 0; i < size; i++)
+        {
+            displs[i] = total;
+            total += counts[i];
+        }
+        all = malloc(total + 1);
+    }
+    MPI_Gatherv(events, bytes, MPI_BYTE, all, counts, displs, MPI_BYTE, 0, MPI_COMM_WORLD);
+
+    if (rank == 0)
+    {
+        struct journal_header h;
+        FILE *out = fopen(journal_path, "wb");
+        long total = 0;
+
+        memset(&h, 0, sizeof(h));
+        memcpy(h.magic, JOURNAL_MAGIC, 8);
+        h.ranks = size;
+        h.search_mode = search_mode;
+        h.search_depth = search_depth;
+        h.snapshot = snapshot_used;
+        h.mpc = mpc_t;
+        memcpy(h.coef, eval_coef, sizeof(h.coef));
+        h.signature = tt_signature();
+        if (out == NULL)
+            fprintf(stderr, "journal: cannot open %s\n", journal_path);
+        else
+        {
+            fwrite(&h, sizeof(h), 1, out);
+            for (int i = 0; i < size; i++)
+            {
+                long long b = counts[i];
+                fwrite(&b, sizeof(b), 1, out);
+                total += counts[i];
+            }
+            fwrite(all, 1, total, out);
+            if (fclose(out) != 0)
+                fprintf(stderr, "journal: cannot write %s\n", journal_path);
+            else
+                printf("journal: %ld events of %d searches from %d ranks written to %s\n",
+                       total / (long)sizeof(struct journal_event), searches, size, journal_path);
+        }
+        free(counts);
+        free(displs);
+        free(all);
+    }
+    free(events);
+    events = NULL;
+    journal_path = NULL;
+}
+
+/**
+ * Entry point for replay, called on every rank. Recorded worker w is
+ * replayed by rank (w - 1) % size and the results go to rank 0, which
+ * makes the choices again and prints the comparison.
+ *
+ * Usage: main --replay <journal> [--move n]
+ *
+ * @param argc
+ * @param argv
+ *
+ * @return SUCCESS if every replayed search matched the journal
+ */
+int journal_replay_main(int argc, char *argv[])
+{
+    struct journal_header *h;
+    struct replay_result *results;
+    long long *bytes;
+    const struct journal_event **stream;
+    long *count;
+    char *data;
+    long length, offset;
+    int target = 0, limit = 0, result = SUCCESS;
+    FILE *in = fopen(argv[2], "rb");
+
+    for (int i = 3; i < argc - 1; i++)
+    {
+        if (strcmp(argv[i], "--move") == 0)
+            target = atoi(argv[i + 1]);
+    }
+    if (in == NULL)
+    {
+        if (rank == 0)
+            fprintf(stderr, "replay: cannot open %s\n", argv[2]);
+        return FAILURE;
+    }
+    fseek(in, 0, SEEK_END);
+    length = ftell(in);
+    rewind(in);
+    data = malloc(length + 1);
+    if (data == NULL || (long)fread(data, 1, length, in) != length)
+    {
+        fprintf(stderr, "replay: cannot read %s\n", argv[2]);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    fclose(in);
+
+    h = (struct journal_header *)data;
+    if (length < (long)sizeof(*h) || memcmp(h->magic, JOURNAL_MAGIC, 8) != 0 || h->ranks < 2 ||
+        length < (long)(sizeof(*h) + h->ranks * sizeof(long long)))
+    {
+        if (rank == 0)
+            fprintf(stderr, "replay: %s is not a journal of a parallel search\n", argv[2]);
+        free(data);
+        return FAILURE;
+    }
+    bytes = (long long *)(h + 1);
+    stream = malloc(h->ranks * sizeof(*stream));
+    count = malloc(h->ranks * sizeof(long));
+    offset = sizeof(*h) + h->ranks * sizeof(long long);
+    for (int r = 0; r < h->ranks; r++)
+    {
+        if (offset + bytes[r] > length)
+        {
+            if (rank == 0)
+                fprintf(stderr, "replay: %s is truncated\n", argv[2]);
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        stream[r] = (const struct journal_event *)(data + offset);
+        count[r] = bytes[r] / sizeof(struct journal_event);
+        offset += bytes[r];
+    }
+    for (long i = 0; i < count[0]; i++)
+        limit += stream[0][i].type == JOURNAL_SEARCH;
+    if (target > limit || target < 0)
+    {
+        if (rank == 0)
+            fprintf(stderr, "replay: the journal has %d searches, not %d\n", limit, target);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    if (target > 0)
+        limit = target;
+
+    /* the game's settings; the bounds would only reach ranks that are not searching */
+    search_mode = h->search_mode;
+    search_depth = h->search_depth;
+    mpc_t = h->mpc;
+    memcpy(eval_coef, h->coef, sizeof(h->coef));
+    share_bounds = 0;
+    if (rank == 0 && h->signature != tt_signature())
+        fprintf(stderr, "replay: the evaluation weights differ from the game's, results will too\n");
+    if (rank == 0 && h->snapshot)
+        fprintf(stderr, "replay: the game probed a snapshot table, which has changed since\n");
+
+    /* a private table per rank, emptied for every worker replayed */
+    if (tt_table != NULL)
+        tt_free();
+    if (tt_init(0) == FAILURE)
+    {
+        fprintf(stderr, "replay: cannot allocate the transposition table\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    results = calloc((size_t)h->ranks * (limit + 1), sizeof(struct replay_result));
+    for (int w = 1; w < h->ranks; w++)
+    {
+        struct replay_result *res = &results[(size_t)w * (limit + 1)];
+        int owner = (w - 1) % size;
+
+        if (owner == rank)
+            replay_worker(stream[w], count[w], limit, res);
+        if (owner != 0 && rank == 0)
+            MPI_Recv(res, (limit + 1) * sizeof(struct replay_result), MPI_BYTE, owner, JOURNAL_REPLAY,
+                     MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        else if (owner != 0 && owner == rank)
+            MPI_Send(res, (limit + 1) * sizeof(struct replay_result), MPI_BYTE, 0, JOURNAL_REPLAY,
+                     MPI_COMM_WORLD);
+    }
+
+    if (rank == 0)
+    {
+        printf("replay: %s, %d ranks recorded, %d searches, replayed on %d ranks\n", argv[2], h->ranks,
+               limit, size);
+        for (int s = 1; s <= limit; s++)
+        {
+            for (int w = 1; w < h->ranks; w++)
+                if (results[(size_t)w * (limit + 1) + s].searched == 1 &&
+                    !same(&results[(size_t)w * (limit + 1) + s]))
+                    result = FAILURE;
+        }
+        report(h, stream[0], count[0], results, limit, target);
+    }
+    MPI_Bcast(&result, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    free(results);
+    free(stream);
+    free(count);
+    free(data);
+    return result;
+}
+
+static struct journal_event *add(int type)
+{
+    struct journal_event *e;
+
+    if (recorded == capacity)
+    {
+        e = realloc(events, 2 * capacity * sizeof(struct journal_event));
+        if (e == NULL)
+        {
+            fprintf(stderr, "journal: rank %d out of memory, recording stops\n", rank);
+            journal_on = 0;
+            return NULL;
+        }
+        events = e;
+        capacity *= 2;
+    }
+    e = &events[recorded++];
+    memset(e, 0, sizeof(*e));
+    e->type = type;
+    e->search = searches;
+    e->nodes = nodes;
+    e->time = MPI_Wtime() - origin;
+    return e;
+}
+
+/*
+    Replays one worker's searches up to limit from an empty table, so
+    that the table is in the state the game left it in at each search.
+    res is indexed by search number.
+ */
+static void replay_worker(const struct journal_event *e, long n, int limit, struct replay_result *res)
+{
+    struct replay_result *r = NULL;
+    double start = 0, rec_start = 0;
+
+    tt_clear();
+    tt_generation = 0;
+    for (long i = 0; i < n && e[i].search <= limit; i++)
+    {
+        switch (e[i].type)
+        {
+        case JOURNAL_SEARCH:
+            r = &res[e[i].search];
+            r->searched = e[i].b == SEARCH_MCTS ? -1 : 1;
+            r->mode = e[i].b;
+            r->move = -1;
+            r->score = ALPHA - 1;
+            r->complete = 1;
+            r->depth = e[i].c;
+            my_colour = e[i].a;
+            search_depth = e[i].c;
+            bb_to_board(e[i].P, e[i].O, my_colour, board);
+            tt_new_search();
+            nodes = 0;
+            rec_start = e[i].time;
+            if (e[i].b != SEARCH_LAZY)
+                break;
+
+            /* stop where the game's search was stopped, if it was */
+            lazy_stop_at = LLONG_MAX;
+            for (long j = i + 1; j < n && e[j].search == e[i].search && e[j].type != JOURNAL_RESULT; j++)
+            {
+                if (e[j].type == JOURNAL_STOP)
+                    lazy_stop_at = e[j].nodes;
+            }
+            struct lazy_result lr;
+            start = MPI_Wtime();
+            lazy_search(e[i].d, &lr);
+            r->seconds = MPI_Wtime() - start;
+            lazy_stop_at = -1;
+            search_stopped = 0;
+            r->move = lr.move > -1 ? BITSQUARE[lr.move] : -1;
+            r->score = lr.score;
+            r->complete = lr.complete;
+            r->depth = lr.depth;
+            r->nodes = lr.nodes;
+            break;
+
+        case JOURNAL_ROOT:
+            if (r == NULL || r->searched != 1 || r->roots == JOURNAL_MAXROOT)
+                break;
+            start = MPI_Wtime();
+            int score = search_move(PLAYABLE[e[i].a], my_colour, search_depth, ALPHA);
+            r->seconds += MPI_Wtime() - start;
+            r->root[r->roots++] = (struct replay_root){e[i].a, score, nodes, e[i].b, e[i].nodes};
+            if (score > r->score)
+            {
+                r->score = score;
+                r->move = e[i].a;
+            }
+            r->nodes = nodes;
+            break;
+
+        case JOURNAL_SHARE_IN:
+            if (r != NULL)
+                r->shares_in++;
+            break;
+
+        case JOURNAL_SHARE_OUT:
+            if (r != NULL)
+                r->shares_out++;
+            break;
+
+        case JOURNAL_RESULT:
+            if (r == NULL)
+                break;
+            r->rec_move = e[i].a;
+            r->rec_score = e[i].b;
+            r->rec_complete = e[i].c;
+            r->rec_nodes = e[i].nodes;
+            r->rec_seconds = e[i].time - rec_start;
+            break;
+        }
+    }
+}
+
+/*
+    Rank 0 makes each search's choice again, the way parallel_search()
+    and lazy_master() made it, taking the workers in recorded arrival
+    order, and prints it beside the journal's.
+ */
+static void report(const struct journal_header *h, const struct journal_event *e, long n,
+                   struct replay_result *res, int limit, int target)
+{
+    int exact = 0, replayed = 0;
+    long i = 0;
+
+    if (target == 0)
+        printf("search  move  score         nodes  recorded  replayed\n");
+    for (int s = 1; s <= limit; s++)
+    {
+        const struct journal_event *search = NULL, *choice = NULL;
+        int move = -1, score = ALPHA - 1, depth = -1, all_same = 1, mode;
+        long long total = 0;
+        double slowest = 0;
+
+        for (; i < n && e[i].search <= s; i++)
+        {
+            const struct replay_result *r;
+            if (e[i].type == JOURNAL_SEARCH)
+                search = &e[i];
+            else if (e[i].type == JOURNAL_CHOICE)
+                choice = &e[i];
+            if (e[i].type != JOURNAL_ARRIVAL || e[i].a < 1 || e[i].a >= h->ranks)
+                continue;
+            r = &res[(size_t)e[i].a * (limit + 1) + s];
+            if (r->searched == 1)
+            {
+                total += r->nodes;
+                all_same &= same(r);
+                if (r->seconds > slowest)
+                    slowest = r->seconds;
+                if (r->mode == SEARCH_LAZY ? r->complete && r->depth > depth : r->move > -1 && r->score > score)
+                {
+                    move = r->move;
+                    score = r->score;
+                    depth = r->depth;
+                }
+            }
+        }
+        if (search == NULL || choice == NULL)
+            continue;
+        mode = search->b;
+        if (mode == SEARCH_MCTS)
+        {
+            if (target == 0)
+                printf("%6d  mcts, not replayed\n", s);
+            continue;
+        }
+        if (mode == SEARCH_LAZY && move == -1)
+            score = ALPHA;
+        replayed++;
+        all_same &= move == choice->a && score == choice->b && total == choice->nodes;
+        exact += all_same;
+
+        if (target == 0 || s == target)
+        {
+            if (s == target)
+                printf("search %d: %s, depth %d, %s to move\n", s, mode == SEARCH_LAZY ? "lazy" : "split", search->c,
+                       search->a == BLACK ? "black" : "white");
+            if (target == 0)
+            {
+                printf("%6d  ", s);
+                write_square(move);
+                printf("  %+5d  %12lld  %7.3fs  %7.3fs  %s", score, total, choice->time - search->time, slowest,
+                       all_same ? "same" : "differs: recorded ");
+                if (!all_same)
+                {
+                    write_square(choice->a);
+                    printf(" %+d %lld nodes", choice->b, choice->nodes);
+                }
+                printf("\n");
+            }
+        }
+        if (s != target)
+            continue;
+
+        /* the breakdown, worker by worker and root move by root move */
+        printf("worker  roots  move  score         nodes      recorded     time  recorded  bounds in/out\n");
+        for (int w = 1; w < h->ranks; w++)
+        {
+            const struct replay_result *r = &res[(size_t)w * (limit + 1) + s];
+            if (r->searched != 1)
+                continue;
+            printf("%6d  %5d  ", w, r->roots);
+            write_square(r->move);
+            printf("  %+5d  %12lld  %12lld  %6.3fs  %6.3fs  %5d/%d%s%s\n", r->score, r->nodes, r->rec_nodes,
+                   r->seconds, r->rec_seconds, r->shares_in, r->shares_out,
+                   r->mode == SEARCH_LAZY && !r->complete ? "  stopped" : "", same(r) ? "" : "  differs");
+            for (int k = 0; k < r->roots; k++)
+            {
+                long long before = k > 0 ? r->root[k - 1].nodes : 0, rec_before = k > 0 ? r->root[k - 1].rec_nodes : 0;
+                printf("          ");
+                write_square(r->root[k].square);
+                printf("  %+5d  %12lld  %12lld", r->root[k].score, r->root[k].nodes - before,
+                       r->root[k].rec_nodes - rec_before);
+                if (r->root[k].score != r->root[k].rec_score)
+                    printf("  recorded %+d", r->root[k].rec_score);
+                printf("\n");
+            }
+        }
+        printf("chosen ");
+        write_square(move);
+        printf(" %+d, %lld nodes; recorded ", score, total);
+        write_square(choice->a);
+        printf(" %+d, %lld nodes, %.3fs\n", choice->b, choice->nodes, choice->time - search->time);
+    }
+    printf("replay: %d of %d searches reproduced exactly\n", exact, replayed);
+}
+
+/* the replay matches the journal */
+static int same(const struct replay_result *r)
+{
+    return r->move == r->rec_move && r->score == r->rec_score && r->nodes == r->rec_nodes &&
+           r->complete == r->rec_complete;
+}
+
+static void write_square(int sq)
+{
+    if (sq < 0)
+        printf("pass");
+    else
+        printf("  %d%d", sq / 8, sq % 8);
+}
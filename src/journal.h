@@ -0,0 +1,83 @@
+#ifndef _JOURNAL_H
+#define _JOURNAL_H
+
+#include <stdint.h>
+#include "evaluate.h"
+
+/*
+    Search journal (--journal file) and replay (--replay file). A
+    recording rank logs every search it is given, each root move it
+    searched with its score, the bounds it received and sent in
+    alpha_beta_sharing(), the node count at which a lazy search was told
+    to stop, and its result; rank 0 logs the order the results arrived
+    in and the move it chose. Every event carries the rank's node count,
+    which is the search's own clock, and the time. At game_over() the
+    logs are gathered into one file.
+
+    Replay runs the recorded workers' searches again on any number of
+    ranks, one rank replaying one or more workers in turn, each from an
+    empty table, so every worker's table holds what it held in the game.
+    A lazy search stops at its recorded node count instead of waiting
+    for a message, and rank 0's choice is made again in the recorded
+    arrival order. Received bounds are not fed back: they only ever
+    tighten the sender's copy of the window, so a search never depends
+    on them. Split searches therefore replay exactly, node for node.
+    Lazy searches shared a table between the ranks of a node, whose
+    hits depend on timing no log can reproduce; they are replayed with
+    private tables and reported where they diverge. MCTS runs for a
+    fixed time and is not replayed.
+        main --replay <journal> [--move n]
+    Without --move every search is replayed with a line each; with it,
+    the searches up to n are replayed and search n is broken down by
+    worker and root move. The settings (search mode, depth, mpc_t and
+    evaluation coefficients) come from the journal; the weights have to
+    be the same as in the game, which is checked.
+ */
+#define JOURNAL_MAGIC "OTHJRNL1"
+#define JOURNAL_REPLAY 50 /* tag of replayed results */
+
+/* event types, the meaning of a, b, c, d */
+#define JOURNAL_SEARCH 0    /* colour, search mode, depth, helper; P and O are the position */
+#define JOURNAL_ROOT 1      /* square, score */
+#define JOURNAL_SHARE_IN 2  /* from, alpha, beta */
+#define JOURNAL_SHARE_OUT 3 /* -, alpha, beta */
+#define JOURNAL_STOP 4
+#define JOURNAL_RESULT 5    /* square or -1, score, complete, depth */
+#define JOURNAL_ARRIVAL 6   /* rank 0: rank whose result came in */
+#define JOURNAL_CHOICE 7    /* rank 0: square or -1, score; nodes over all workers */
+
+struct journal_event
+{
+    uint64_t P; /* side to move */
+    uint64_t O;
+    long long nodes;
+    double time; /* seconds from the start of the run */
+    int type;
+    int search; /* numbered from 1 on every rank */
+    int a, b, c, d;
+};
+
+struct journal_header
+{
+    char magic[8];
+    int ranks;
+    int search_mode;
+    int search_depth;
+    int snapshot; /* a snapshot table was in use */
+    double mpc;
+    int coef[EVAL_TERMS];
+    uint64_t signature; /* of the evaluation settings, see tt.c */
+    /* followed by long long bytes[ranks] and each rank's events */
+};
+
+extern int journal_on;
+
+void journal_init(const char *path, int snapshot);
+void journal_search(int helper);
+void journal_record(int type, int a, int b, int c, int d);
+void journal_result(int move, int score, int complete, int depth);
+void journal_arrival(int from);
+void journal_finish();
+int journal_replay_main(int argc, char *argv[]);
+
+#endif
@@ -0,0 +1,164 @@
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <mpi.h>
+#include "comms.h"
+#include "player.h"
+#include "lazy.h"
+#include "tt.h"
+#include "journal.h"
+
+int lazy_active = 0;
+double lazy_grace = LAZY_GRACE;
+long long lazy_stop_at = -1;
+static int abort_received;
+
+/**
+ * Function to run one worker's share of a lazy SMP search, on the board
+ * and colour rank 0 just sent. Sends the result to rank 0 and consumes
+ * the stop message that follows every search.
+ */
+void lazy_worker()
+{
+    struct lazy_result res;
+    double start = MPI_Wtime();
+
+    abort_received = 0;
+    lazy_search(rank - 1, &res);
+    search_busy += MPI_Wtime() - start; /* not the wait for the stop message */
+    journal_result(res.move, res.score, res.complete, res.depth);
+    MPI_Send(&res, sizeof(res), MPI_BYTE, 0, LAZY_RESULT, MPI_COMM_WORLD);
+    if (!abort_received)
+        MPI_Recv(NULL, 0, MPI_BYTE, 0, LAZY_ABORT, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    search_stopped = 0;
+}
+
+/**
+ * Function to search every root move of the global board as one helper,
+ * each starting at its own offset. The odd helpers search to the depth
+ * and then one ply deeper. Stops early when lazy_poll() says so, leaving
+ * search_stopped set; the result is the deepest iteration completed.
+ *
+ * @param helper  number of the helper, from 0
+ * @param res
+ */
+void lazy_search(int helper, struct lazy_result *res)
+{
+    int root[LEGALMOVSBUFSIZE];
+
+    res->move = -1;
+    res->score = ALPHA;
+    res->depth = -1;
+    memcpy(root, legalmoves(my_colour), LEGALMOVSBUFSIZE * sizeof(int));
+    nodes = 0;
+    search_stopped = 0;
+    lazy_active = 1;
+    for (int depth = search_depth; depth <= search_depth + helper % 2 && !search_stopped; depth++)
+    {
+        int best_move = -1, best_score = ALPHA;
+        for (int k = 0; k < root[0]; k++)
+        {
+            int move = root[1 + (k + helper) % root[0]];
+            int score = search_move(move, my_colour, depth, best_score);
+            if (search_stopped)
+                break;
+            if (best_move == -1 || score > best_score)
+            {
+                best_move = move;
+                best_score = score;
+            }
+        }
+        if (!search_stopped)
+        {
+            res->move = best_move;
+            res->score = best_score;
+            res->depth = depth;
+        }
+    }
+    lazy_active = 0;
+    res->complete = res->depth >= 0;
+    res->nodes = nodes;
+}
+
+/**
+ * Function to collect a lazy SMP search on rank 0. Once the first result
+ * is in, the helpers still searching one ply deeper get lazy_grace times
+ * its time to finish, then every worker is told to stop. With no workers
+ * rank 0 searches alone, as helper 0, and nothing can stop it early.
+ *
+ * @param best_score
+ *
+ * @return chosen move, -1 to pass
+ */
+int lazy_master(int *best_score)
+{
+    struct lazy_result res, best = {-1, ALPHA, -1, 0, 0};
+    MPI_Status status;
+    double start = MPI_Wtime(), deadline = 0;
+    int deepest = search_depth + (size > 2), stopped = 0, flag;
+
+    if (size == 1)
+    {
+        double start = MPI_Wtime();
+        tt_new_search();
+        lazy_stop_at = LLONG_MAX;
+        lazy_search(0, &best);
+        lazy_stop_at = -1;
+        search_stopped = 0;
+        search_busy += MPI_Wtime() - start;
+    }
+    for (int i = 1; i < size; i++)
+    {
+        /* wait for the deeper helpers until the grace period runs out */
+        if (i > 1 && !stopped)
+        {
+            do
+                MPI_Iprobe(MPI_ANY_SOURCE, LAZY_RESULT, MPI_COMM_WORLD, &flag, MPI_STATUS_IGNORE);
+            while (!flag && MPI_Wtime() < deadline);
+        }
+        if (i > 1 && !stopped && !flag)
+        {
+            for (int w = 1; w < size; w++)
+                MPI_Send(NULL, 0, MPI_BYTE, w, LAZY_ABORT, MPI_COMM_WORLD);
+            stopped = 1;
+        }
+        MPI_Recv(&res, sizeof(res), MPI_BYTE, MPI_ANY_SOURCE, LAZY_RESULT, MPI_COMM_WORLD, &status);
+        journal_arrival(status.MPI_SOURCE);
+        if (i == 1)
+            deadline = MPI_Wtime() + lazy_grace * (MPI_Wtime() - start);
+        nodes += res.nodes;
+        if (res.complete && res.depth > best.depth)
+            best = res;
+        if (!stopped && (best.depth >= deepest || i == size - 1))
+        {
+            for (int w = 1; w < size; w++)
+                MPI_Send(NULL, 0, MPI_BYTE, w, LAZY_ABORT, MPI_COMM_WORLD);
+            stopped = 1;
+        }
+    }
+    *best_score = best.score;
+    return best.move;
+}
+
+/*
+    Called from minimax() while a lazy search runs: stop if rank 0 says
+    so, or in a replay at the node count the recorded search stopped at.
+ */
+void lazy_poll()
+{
+    int flag;
+    if (lazy_stop_at >= 0)
+    {
+        if (nodes >= lazy_stop_at)
+            search_stopped = 1;
+        return;
+    }
+    MPI_Iprobe(0, LAZY_ABORT, MPI_COMM_WORLD, &flag, MPI_STATUS_IGNORE);
+    if (flag)
+    {
+        MPI_Recv(NULL, 0, MPI_BYTE, 0, LAZY_ABORT, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        abort_received = 1;
+        search_stopped = 1;
+        journal_record(JOURNAL_STOP, 0, 0, 0, 0);
+    }
+}
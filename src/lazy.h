@@ -0,0 +1,44 @@
+#ifndef _LAZY_H
+#define _LAZY_H
+
+/*
+    Lazy SMP (--search lazy). Every worker searches the whole root
+    position rather than a share of its moves; the only thing they
+    exchange is the transposition table, shared by the ranks of a node.
+    Workers are staggered so they do not walk the tree in lockstep: the
+    odd helpers go on one ply deeper once they finish the depth, and each
+    helper starts the root moves at a different offset. When the first
+    result comes in, rank 0 gives the deeper helpers --lazy-grace
+    (LAZY_GRACE) times the time it took, then tells the rest to stop (they poll every LAZY_POLL
+    + 1 nodes) and takes the deepest completed iteration any of them
+    reports. On a single rank, rank 0 is the only helper and searches the
+    position itself.
+
+    Where the workers stop depends on when the stop message arrives; a
+    journal (see journal.h) keeps the node count each one stopped at, and
+    a replay sets lazy_stop_at so the search stops there again.
+ */
+#define LAZY_RESULT 30
+#define LAZY_ABORT 31
+#define LAZY_POLL 1023
+#define LAZY_GRACE 1.0 /* of the first result's time, for the deeper helpers */
+
+struct lazy_result
+{
+    int move;
+    int score;
+    int depth;
+    int complete;
+    long long nodes;
+};
+
+extern int lazy_active;
+extern double lazy_grace;
+extern long long lazy_stop_at; /* replay: stop at this node count, -1 to poll rank 0 */
+
+void lazy_worker();
+void lazy_search(int helper, struct lazy_result *res);
+int lazy_master(int *best_score);
+void lazy_poll();
+
+#endif
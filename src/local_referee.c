@@ -0,0 +1,267 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <poll.h>
+#include <mpi.h>
+#include "comms.h"
+#include "player.h"
+#include "tables.h"
+#include "bitboard.h"
+#include "transport.h"
+#include "local_referee.h"
+
+#define START_BLACK 0x0000000810000000ULL
+#define START_WHITE 0x0000001008000000ULL
+
+struct referee_game
+{
+    struct transport_conn conn; /* fd -1 once closed */
+    uint64_t black, white;
+    int to_move;
+    int server; /* colour the server plays */
+    int waiting;
+    double asked;
+};
+
+static int total_games, started;
+static int wins, draws, losses, illegal, aborted; /* from the server's view */
+static long replies;
+static double reply_time;
+static uint64_t rng_state;
+
+static void start_game(struct referee_game *g);
+static void advance(struct referee_game *g);
+static void finish_game(struct referee_game *g, int forfeit);
+static void server_reply(struct referee_game *g, const char *line);
+static void send_line(struct referee_game *g, const char *text);
+
+/**
+ * Entry point for the stand-in referee, run on rank 0 only as a job of
+ * its own alongside the server.
+ *
+ * Usage: main --referee address [--games n] [--concurrent k] [--seed s]
+ *
+ * @param argc
+ * @param argv
+ *
+ * @return SUCCESS, or FAILURE if it cannot connect or a move was illegal
+ */
+int local_referee_main(int argc, char *argv[])
+{
+    struct referee_game *games;
+    struct pollfd fds[REFEREE_MAXCONNS];
+    int slot_of[REFEREE_MAXCONNS];
+    int concurrent = REFEREE_CONCURRENT, open_conns = 0;
+    unsigned seed = 1;
+    double start;
+
+    if (rank != 0)
+        return SUCCESS;
+    total_games = REFEREE_GAMES;
+    for (int i = 3; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--games") == 0 && i + 1 < argc)
+            total_games = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--concurrent") == 0 && i + 1 < argc)
+            concurrent = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+            seed = strtoul(argv[++i], NULL, 10);
+    }
+    if (concurrent > REFEREE_MAXCONNS)
+        concurrent = REFEREE_MAXCONNS;
+    if (concurrent > total_games)
+        concurrent = total_games;
+    rng_state = 0x9e3779b97f4a7c15ULL ^ seed;
+
+    start = MPI_Wtime();
+    games = calloc(concurrent, sizeof(struct referee_game));
+    for (int i = 0; i < concurrent; i++)
+    {
+        games[i].conn.fd = transport_connect(argv[2]);
+        if (games[i].conn.fd == FAILURE)
+        {
+            for (int j = 0; j < i; j++)
+                close(games[j].conn.fd);
+            free(games);
+            return FAILURE;
+        }
+    }
+    for (int i = 0; i < concurrent; i++)
+        start_game(&games[i]);
+
+    do
+    {
+        open_conns = 0;
+        for (int i = 0; i < concurrent; i++)
+        {
+            if (games[i].conn.fd < 0)
+                continue;
+            fds[open_conns].fd = games[i].conn.fd;
+            fds[open_conns].events = POLLIN;
+            slot_of[open_conns++] = i;
+        }
+        if (open_conns == 0 || poll(fds, open_conns, -1) < 0)
+            break;
+        for (int k = 0; k < open_conns; k++)
+        {
+            struct referee_game *g = &games[slot_of[k]];
+            char line[TRANSPORT_BUFSIZE];
+
+            if (!(fds[k].revents & (POLLIN | POLLHUP | POLLERR)))
+                continue;
+            if (transport_read(&g->conn) <= 0)
+            {
+                close(g->conn.fd);
+                g->conn.fd = -1;
+                aborted++;
+                continue;
+            }
+            while (g->conn.fd >= 0 && transport_line(&g->conn, line, sizeof(line)))
+                server_reply(g, line);
+        }
+    } while (open_conns > 0);
+    free(games);
+
+    printf("referee: %d games over %d connections in %.2fs: server %d wins %d draws %d losses", started,
+           concurrent, MPI_Wtime() - start, wins, draws, losses);
+    if (illegal || aborted)
+        printf(", %d illegal moves, %d connections lost", illegal, aborted);
+    printf("\nreferee: %ld moves, mean reply %.1f ms\n", replies, replies ? 1000 * reply_time / replies : 0.0);
+    return illegal || aborted ? FAILURE : SUCCESS;
+}
+
+static uint64_t random_next()
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+/*
+    Starts the next game on a connection, or closes it once every game
+    has been started. The server plays black in even games.
+ */
+static void start_game(struct referee_game *g)
+{
+    if (started == total_games)
+    {
+        close(g->conn.fd);
+        g->conn.fd = -1;
+        return;
+    }
+    g->server = started++ % 2 ? WHITE : BLACK;
+    g->black = START_BLACK;
+    g->white = START_WHITE;
+    g->to_move = BLACK;
+    g->waiting = 0;
+    send_line(g, g->server == BLACK ? "new_game b\n" : "new_game w\n");
+    advance(g);
+}
+
+/*
+    Plays the referee's moves and passes until the server is to move, then
+    asks it for a move, or ends the game when neither side can move.
+ */
+static void advance(struct referee_game *g)
+{
+    char text[TRANSPORT_BUFSIZE];
+
+    while (g->conn.fd >= 0)
+    {
+        uint64_t *P = g->to_move == BLACK ? &g->black : &g->white;
+        uint64_t *O = g->to_move == BLACK ? &g->white : &g->black;
+        uint64_t legal = bb_moves(*P, *O);
+
+        if (legal == 0)
+        {
+            if (bb_moves(*O, *P) == 0)
+            {
+                finish_game(g, 0);
+                return;
+            }
+            if (g->to_move != g->server)
+                send_line(g, "play_move pass\n");
+            g->to_move = OPPONENT[g->to_move];
+            continue;
+        }
+        if (g->to_move == g->server)
+        {
+            send_line(g, "gen_move\n");
+            g->waiting = 1;
+            g->asked = MPI_Wtime();
+            return;
+        }
+
+        int pick = random_next() % __builtin_popcountll(legal);
+        while (pick--)
+            legal &= legal - 1;
+        int sq = __builtin_ctzll(legal);
+        uint64_t flips = bb_flips(*P, *O, sq);
+        *P ^= flips | (1ULL << sq);
+        *O ^= flips;
+        snprintf(text, sizeof(text), "play_move %d%d\n", sq / 8, sq % 8);
+        send_line(g, text);
+        g->to_move = OPPONENT[g->to_move];
+    }
+}
+
+/*
+    Checks and plays the move the server sent. It is only asked when it
+    has a legal move, so a pass is as illegal as a bad square.
+ */
+static void server_reply(struct referee_game *g, const char *line)
+{
+    uint64_t *P = g->server == BLACK ? &g->black : &g->white;
+    uint64_t *O = g->server == BLACK ? &g->white : &g->black;
+    int sq = -1;
+
+    if (!g->waiting)
+        return;
+    g->waiting = 0;
+    reply_time += MPI_Wtime() - g->asked;
+    replies++;
+
+    if (line[0] >= '0' && line[0] <= '7' && line[1] >= '0' && line[1] <= '7' && line[2] == 0)
+        sq = (line[0] - '0') * 8 + (line[1] - '0');
+    if (sq < 0 || !(bb_moves(*P, *O) & (1ULL << sq)))
+    {
+        fprintf(stderr, "referee: game %d: illegal move \"%s\"\n", started, line);
+        illegal++;
+        finish_game(g, 1);
+        return;
+    }
+    uint64_t flips = bb_flips(*P, *O, sq);
+    *P ^= flips | (1ULL << sq);
+    *O ^= flips;
+    g->to_move = OPPONENT[g->to_move];
+    advance(g);
+}
+
+static void finish_game(struct referee_game *g, int forfeit)
+{
+    int diff = __builtin_popcountll(g->black) - __builtin_popcountll(g->white);
+
+    if (g->server == WHITE)
+        diff = -diff;
+    if (forfeit || diff < 0)
+        losses++;
+    else if (diff == 0)
+        draws++;
+    else
+        wins++;
+    send_line(g, "game_over\n");
+    start_game(g);
+}
+
+static void send_line(struct referee_game *g, const char *text)
+{
+    if (g->conn.fd >= 0 && transport_send(g->conn.fd, text) == FAILURE)
+    {
+        close(g->conn.fd);
+        g->conn.fd = -1;
+        aborted++;
+    }
+}
@@ -0,0 +1,17 @@
+#ifndef _LOCAL_REFEREE_H
+#define _LOCAL_REFEREE_H
+
+/*
+    Stand-in referee for testing the server (see server.h). It opens a
+    number of connections at once and on each plays games one after
+    another against the server with a random mover, alternating the
+    server's colour. Every move the server sends is checked, and at the
+    end it prints the results and the server's mean reply time.
+ */
+#define REFEREE_GAMES 10
+#define REFEREE_CONCURRENT 4
+#define REFEREE_MAXCONNS 256
+
+int local_referee_main(int argc, char *argv[]);
+
+#endif
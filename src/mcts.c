@@ -0,0 +1,310 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <mpi.h>
+#include "comms.h"
+#include "player.h"
+#include "tables.h"
+#include "bitboard.h"
+#include "mcts.h"
+#include "topology.h"
+
+#define CORNERS 0x8100000000000081ULL
+
+int mcts_threads = MCTS_THREADS;
+int mcts_time = MCTS_TIME;
+
+static struct mcts_node *pool;
+static int pool_used;
+static volatile int stop;
+static long long playouts[MCTS_MAXTHREADS];
+
+static void *search_thread(void *arg);
+static void run_playouts(int thread, uint64_t *rng, int count);
+static int expand(int node);
+static int select_child(int node);
+static int playout(uint64_t P, uint64_t O, uint64_t *rng);
+static void merge_root(int *last_visits, int *last_wins, double *elapsed);
+
+static inline uint64_t next_random(uint64_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+/**
+ * Function to search board for my_colour, called on every rank with
+ * the same board. Returns once --mcts-time has passed on the slowest
+ * rank; all ranks end up with the same root counts and the same move.
+ * nodes is set to the playouts of all ranks.
+ *
+ * @param best_score  win rate of the chosen move in tenths of a percent
+ *
+ * @return chosen move, -1 to pass
+ */
+int mcts_search(int *best_score)
+{
+    pthread_t threads[MCTS_MAXTHREADS];
+    int last_visits[64], last_wins[64];
+    double elapsed = 0;
+    uint64_t rng = 0x9e3779b97f4a7c15ULL * (rank + 1);
+    int root = 0, best = -1;
+
+    if (pool == NULL)
+        pool = topology_alloc(MCTS_NODES * sizeof(struct mcts_node));
+    pool_used = 1;
+    memset(&pool[root], 0, sizeof(struct mcts_node));
+    bb_from_board(board, my_colour, &pool[root].P, &pool[root].O);
+    pool[root].parent = -1;
+    pool[root].move = MCTS_PASS;
+    memset(playouts, 0, sizeof(playouts));
+
+    /* the root's children are the same on every rank, so they can be merged */
+    *best_score = 0;
+    if (expand(root) == 0)
+        return -1;
+    for (int i = 0; i < pool[root].num_children; i++)
+    {
+        last_visits[i] = 0;
+        last_wins[i] = 0;
+    }
+
+    stop = 0;
+    if (mcts_threads > MCTS_MAXTHREADS)
+        mcts_threads = MCTS_MAXTHREADS;
+    for (long t = 1; t < mcts_threads; t++)
+        pthread_create(&threads[t], NULL, search_thread, (void *)t);
+
+    /* thread 0 also does the merging, the only MPI calls */
+    double start = MPI_Wtime();
+    while (elapsed < mcts_time / 1000.0)
+    {
+        double begin = MPI_Wtime(), next = begin + MCTS_MERGE;
+        while (MPI_Wtime() < next)
+            run_playouts(0, &rng, 64);
+        search_busy += MPI_Wtime() - begin; /* the merges are communication */
+        elapsed = MPI_Wtime() - start;
+        merge_root(last_visits, last_wins, &elapsed);
+    }
+    stop = 1;
+    for (int t = 1; t < mcts_threads; t++)
+        pthread_join(threads[t], NULL);
+    merge_root(last_visits, last_wins, &elapsed);
+
+    long long total = 0;
+    for (int t = 0; t < mcts_threads; t++)
+        total += playouts[t];
+    MPI_Allreduce(&total, &nodes, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+
+    struct mcts_node *children = &pool[pool[root].first_child];
+    for (int i = 0; i < pool[root].num_children; i++)
+    {
+        if (best == -1 || children[i].visits > children[best].visits)
+            best = i;
+    }
+    *best_score = children[best].visits ? (int)(500LL * children[best].wins / children[best].visits) : 0;
+    if (children[best].move == MCTS_PASS)
+        return -1;
+    return PLAYABLE[children[best].move];
+}
+
+static void *search_thread(void *arg)
+{
+    int thread = (int)(long)arg;
+    uint64_t rng = 0x9e3779b97f4a7c15ULL * (rank + 1) + 0x632be59bd9b4e019ULL * thread;
+
+    topology_pin_thread(thread);
+    while (!stop)
+        run_playouts(thread, &rng, 64);
+    return NULL;
+}
+
+/*
+    Select, expand, play out and back up, count times.
+ */
+static void run_playouts(int thread, uint64_t *rng, int count)
+{
+    for (int n = 0; n < count; n++)
+    {
+        int node = 0, result;
+
+        /* descend, adding a virtual loss on the way */
+        while (__atomic_load_n(&pool[node].state, __ATOMIC_ACQUIRE) == 2 && pool[node].num_children > 0)
+        {
+            node = select_child(node);
+            __atomic_add_fetch(&pool[node].vloss, MCTS_VIRTUAL_LOSS, __ATOMIC_RELAXED);
+        }
+        if (pool[node].visits > 0 && expand(node) > 0)
+        {
+            node = pool[node].first_child;
+            __atomic_add_fetch(&pool[node].vloss, MCTS_VIRTUAL_LOSS, __ATOMIC_RELAXED);
+        }
+
+        /* result in half points for the side to move at the leaf */
+        result = playout(pool[node].P, pool[node].O, rng);
+        for (; node >= 0; node = pool[node].parent)
+        {
+            result = 2 - result; /* now for the side that moved into node */
+            __atomic_add_fetch(&pool[node].visits, 1, __ATOMIC_RELAXED);
+            __atomic_add_fetch(&pool[node].wins, result, __ATOMIC_RELAXED);
+            if (node != 0)
+                __atomic_sub_fetch(&pool[node].vloss, MCTS_VIRTUAL_LOSS, __ATOMIC_RELAXED);
+        }
+    }
+    playouts[thread] += count;
+}
+
+/**
+ * Function to add the children of a node, if no other thread has.
+ *
+ * @param node
+ *
+ * @return number of children, 0 if the game is over, the node is taken
+ *         or the pool is full
+ */
+static int expand(int node)
+{
+    struct mcts_node *n = &pool[node];
+    uint64_t legal = bb_moves(n->P, n->O);
+    int expected = 0, count, first;
+
+    if (legal == 0 && bb_moves(n->O, n->P) == 0)
+        return 0;
+    if (!__atomic_compare_exchange_n(&n->state, &expected, 1, 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+        return 0;
+
+    count = legal ? __builtin_popcountll(legal) : 1;
+    first = __atomic_fetch_add(&pool_used, count, __ATOMIC_RELAXED);
+    if (first + count > MCTS_NODES)
+        return 0; /* stays in state 1: played out from here on */
+
+    for (int i = 0; i < count; i++)
+    {
+        struct mcts_node *c = &pool[first + i];
+        memset(c, 0, sizeof(*c));
+        c->parent = node;
+        if (legal == 0)
+        {
+            c->move = MCTS_PASS;
+            c->P = n->O;
+            c->O = n->P;
+            continue;
+        }
+        int sq = __builtin_ctzll(legal);
+        uint64_t flips = bb_flips(n->P, n->O, sq);
+        legal &= legal - 1;
+        c->move = sq;
+        c->P = n->O ^ flips;
+        c->O = n->P ^ flips ^ (1ULL << sq);
+    }
+    n->first_child = first;
+    n->num_children = count;
+    __atomic_store_n(&n->state, 2, __ATOMIC_RELEASE);
+    return count;
+}
+
+/*
+    UCT, counting virtual losses as visits that were lost.
+ */
+static int select_child(int node)
+{
+    struct mcts_node *n = &pool[node];
+    double log_visits = log((double)n->visits + n->vloss + 1);
+    double best_value = -1;
+    int best = n->first_child;
+
+    for (int i = n->first_child; i < n->first_child + n->num_children; i++)
+    {
+        int visits = pool[i].visits + pool[i].vloss;
+        double value;
+        if (visits == 0)
+            return i;
+        value = pool[i].wins / (2.0 * visits) + MCTS_UCT_C * sqrt(log_visits / visits);
+        if (value > best_value)
+        {
+            best_value = value;
+            best = i;
+        }
+    }
+    return best;
+}
+
+/**
+ * Function to play random moves to the end of the game, taking a corner
+ * half of the time one is available.
+ *
+ * @param P
+ * @param O
+ * @param rng
+ *
+ * @return 2 if P wins, 1 for a draw, 0 if P loses
+ */
+static int playout(uint64_t P, uint64_t O, uint64_t *rng)
+{
+    int side = 0, passes = 0;
+
+    while (passes < 2)
+    {
+        uint64_t legal = bb_moves(P, O), tmp;
+        if (legal == 0)
+            passes++;
+        else
+        {
+            uint64_t r = next_random(rng);
+            passes = 0;
+            if ((legal & CORNERS) && (r & 1))
+                legal &= CORNERS;
+            for (int pick = (r >> 1) % __builtin_popcountll(legal); pick > 0; pick--)
+                legal &= legal - 1;
+            int sq = __builtin_ctzll(legal);
+            uint64_t flips = bb_flips(P, O, sq);
+            P ^= flips | (1ULL << sq);
+            O ^= flips;
+        }
+        tmp = P;
+        P = O;
+        O = tmp;
+        side ^= 1;
+    }
+    /* side is 1 when P and O are swapped from the start */
+    int diff = __builtin_popcountll(side ? O : P) - __builtin_popcountll(side ? P : O);
+    return diff > 0 ? 2 : diff == 0 ? 1 : 0;
+}
+
+/**
+ * Function to add the other ranks' root child counts since the last
+ * merge into this rank's tree. elapsed becomes the largest over the
+ * ranks, so they all agree when to stop.
+ *
+ * @param last_visits  counts as of the last merge
+ * @param last_wins
+ * @param elapsed
+ */
+static void merge_root(int *last_visits, int *last_wins, double *elapsed)
+{
+    int n = pool[0].num_children;
+    int local[2 * 64] = {0}, global[2 * 64] = {0};
+    struct mcts_node *children = &pool[pool[0].first_child];
+    int root_visits = 0;
+
+    for (int i = 0; i < n; i++)
+    {
+        local[i] = __atomic_load_n(&children[i].visits, __ATOMIC_RELAXED) - last_visits[i];
+        local[n + i] = __atomic_load_n(&children[i].wins, __ATOMIC_RELAXED) - last_wins[i];
+    }
+    MPI_Allreduce(local, global, 2 * n, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+    MPI_Allreduce(MPI_IN_PLACE, elapsed, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+    for (int i = 0; i < n; i++)
+    {
+        __atomic_add_fetch(&children[i].visits, global[i] - local[i], __ATOMIC_RELAXED);
+        __atomic_add_fetch(&children[i].wins, global[n + i] - local[n + i], __ATOMIC_RELAXED);
+        last_visits[i] += global[i];
+        last_wins[i] += global[n + i];
+        root_visits += global[i] - local[i];
+    }
+    __atomic_add_fetch(&pool[0].visits, root_visits, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,50 @@
+#ifndef _MCTS_H
+#define _MCTS_H
+
+#include <stdint.h>
+
+/*
+    Monte Carlo tree search (--search mcts), a second engine beside
+    minimax(). UCT selection, one node expanded per playout, and
+    playouts that play random moves on bitboards, taking an available
+    corner half of the time.
+
+    Inside a rank MCTS_THREADS (--threads) threads grow one tree. A
+    thread walking down a node adds a virtual loss to it, so the others
+    spread out instead of piling into the same line; visit and win
+    counts are updated with atomics and a node is expanded by whichever
+    thread claims it first. Across ranks each rank grows its own tree
+    from the same root, and every MCTS_MERGE seconds the ranks add up the
+    visit and win counts of the root's children with MPI_Allreduce, so
+    every tree sees what all of them have learnt. The search runs for
+    --mcts-time milliseconds and plays the root child with most visits.
+ */
+#define MCTS_NODES (1 << 20) /* per rank */
+#define MCTS_THREADS 1
+#define MCTS_MAXTHREADS 64
+#define MCTS_TIME 1000       /* ms per move */
+#define MCTS_MERGE 0.05
+#define MCTS_UCT_C 1.0
+#define MCTS_VIRTUAL_LOSS 1
+#define MCTS_PASS 64         /* move of a pass child */
+
+struct mcts_node
+{
+    uint64_t P; /* side to move */
+    uint64_t O;
+    int parent;
+    int first_child;  /* children are consecutive in the pool */
+    int num_children;
+    int state;        /* 0 leaf, 1 being expanded, 2 expanded */
+    int move;         /* square played to get here */
+    int visits;
+    int wins;         /* half points for the side that played move */
+    int vloss;
+};
+
+extern int mcts_threads;
+extern int mcts_time;
+
+int mcts_search(int *best_score);
+
+#endif
@@ -0,0 +1,365 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <mpi.h>
+#include "comms.h"
+#include "player.h"
+#include "bitboard.h"
+#include "batch.h"
+#include "bench.h"
+#include "mpc.h"
+
+double mpc_t = 0.0;
+struct mpc_params mpc_table[MPC_STAGES][MPC_MAXDEPTH + 1][MPC_CHECKS];
+
+/*
+    Built in parameters: stage, depth, check, a, b, sigma. Fitted with
+    --mpc-fit on 2000 random playout positions searched to depth 7, with
+    the default evaluation coefficients 1,20,3.
+ */
+static const double mpc_defaults[][6] = {
+    {0, 3, 0, 1.106, -7.329, 66.162},
+    {0, 4, 0, 1.160, -86.707, 85.607},
+    {0, 4, 1, 1.112, 4.417, 67.287},
+    {0, 5, 0, 1.205, -10.548, 112.361},
+    {0, 5, 1, 1.155, 84.149, 97.985},
+    {0, 6, 0, 1.207, -0.003, 123.122},
+    {0, 6, 1, 1.158, -92.196, 95.110},
+    {0, 7, 0, 1.242, 84.344, 151.626},
+    {0, 7, 1, 1.199, -11.139, 123.213},
+    {1, 3, 0, 1.182, -10.318, 59.769},
+    {1, 4, 0, 1.239, -63.716, 79.070},
+    {1, 4, 1, 1.148, 7.444, 53.670},
+    {1, 5, 0, 1.324, -15.714, 90.756},
+    {1, 5, 1, 1.222, 60.385, 69.533},
+    {1, 6, 0, 1.274, 14.851, 85.136},
+    {1, 6, 1, 1.180, -53.369, 68.373},
+    {1, 7, 0, 1.347, 68.251, 100.176},
+    {1, 7, 1, 1.254, -4.357, 80.035},
+    {2, 3, 0, 1.203, -6.577, 45.319},
+    {2, 4, 0, 1.284, -38.550, 58.662},
+    {2, 4, 1, 1.171, 6.307, 41.502},
+    {2, 5, 0, 1.380, -14.147, 69.161},
+    {2, 5, 1, 1.255, 34.148, 54.551},
+    {2, 6, 0, 1.337, 6.361, 65.344},
+    {2, 6, 1, 1.238, -37.875, 49.510},
+    {2, 7, 0, 1.413, 32.664, 76.258},
+    {2, 7, 1, 1.316, -14.475, 57.976},
+    {3, 3, 0, 1.177, -3.914, 27.915},
+    {3, 4, 0, 1.255, -23.131, 38.242},
+    {3, 4, 1, 1.188, 1.854, 28.724},
+    {3, 5, 0, 1.340, -7.333, 48.135},
+    {3, 5, 1, 1.268, 19.356, 39.940},
+    {3, 6, 0, 1.343, 3.933, 48.508},
+    {3, 6, 1, 1.252, -21.169, 35.941},
+    {3, 7, 0, 1.427, 19.811, 56.357},
+    {3, 7, 1, 1.339, -7.158, 42.745},
+    {4, 3, 0, 1.051, -2.212, 17.396},
+    {4, 4, 0, 1.071, -13.686, 22.467},
+    {4, 4, 1, 1.081, 1.129, 17.241},
+    {4, 5, 0, 1.118, -2.209, 27.444},
+    {4, 5, 1, 1.110, 13.494, 24.966},
+    {4, 6, 0, 1.149, 2.968, 28.702},
+    {4, 6, 1, 1.118, -11.321, 22.020},
+    {4, 7, 0, 1.196, 13.269, 34.224},
+    {4, 7, 1, 1.185, -2.185, 25.674},
+    {5, 3, 0, 0.969, 0.572, 13.552},
+    {5, 4, 0, 0.969, -4.643, 16.097},
+    {5, 4, 1, 0.985, 1.341, 11.294},
+    {5, 5, 0, 0.947, 1.553, 16.854},
+    {5, 5, 1, 0.933, 7.591, 14.697},
+    {5, 6, 0, 0.981, 1.546, 15.187},
+    {5, 6, 1, 1.008, -5.139, 12.400},
+    {5, 7, 0, 0.932, 7.083, 17.194},
+    {5, 7, 1, 0.989, 0.326, 12.727},
+};
+
+static int test_at_least(uint64_t P, uint64_t O, int current_depth, int shallow, int player, int bound);
+static int test_at_most(uint64_t P, uint64_t O, int current_depth, int shallow, int player, int bound);
+
+/**
+ * Function to fill the parameter table with the built in fit.
+ */
+void mpc_init()
+{
+    memset(mpc_table, 0, sizeof(mpc_table));
+    for (int i = 0; i < (int)(sizeof(mpc_defaults) / sizeof(mpc_defaults[0])); i++)
+    {
+        struct mpc_params *m = &mpc_table[(int)mpc_defaults[i][0]][(int)mpc_defaults[i][1]][(int)mpc_defaults[i][2]];
+        m->a = mpc_defaults[i][3];
+        m->b = mpc_defaults[i][4];
+        m->sigma = mpc_defaults[i][5];
+    }
+}
+
+/**
+ * Function to get the shallow depth of a check. The first check is a
+ * cheap one or two ply search, the second one searches half the depth.
+ *
+ * @param depth  plies left at the node
+ * @param check  0 .. MPC_CHECKS - 1
+ *
+ * @return shallow depth, 0 if there is no such check
+ */
+int mpc_check_depth(int depth, int check)
+{
+    int cheap = depth <= 5 ? 1 : 2;
+    if (depth < MPC_MINDEPTH || depth > MPC_MAXDEPTH)
+        return 0;
+    if (check == 0)
+        return cheap;
+    return depth / 2 > cheap ? depth / 2 : 0;
+}
+
+/**
+ * Function to try to cut a node with the shallow searches. Scores are
+ * from my_colour's view like the rest of minimax(), the model is fitted
+ * from the view of the side to move.
+ *
+ * @param P       side to move
+ * @param O
+ * @param current_depth
+ * @param max_depth
+ * @param player
+ * @param alpha
+ * @param beta
+ * @param score   value to return from the node if it is cut
+ *
+ * @return 1 if the node is cut
+ */
+int mpc_prune(uint64_t P, uint64_t O, int current_depth, int max_depth, int player,
+              int alpha, int beta, int *score)
+{
+    int depth = max_depth - current_depth;
+    int stage = (64 - __builtin_popcountll(P | O)) / 10;
+    int sign = player == my_colour ? 1 : -1;
+    int node_alpha = sign > 0 ? alpha : -beta;
+    int node_beta = sign > 0 ? beta : -alpha;
+
+    for (int check = 0; check < MPC_CHECKS; check++)
+    {
+        int shallow = mpc_check_depth(depth, check);
+        struct mpc_params *m = &mpc_table[stage][depth < MPC_MAXDEPTH ? depth : MPC_MAXDEPTH][check];
+        if (shallow == 0 || m->sigma <= 0 || m->a <= 0)
+            continue;
+
+        /* v_deep >= node_beta is very likely */
+        int bound = (int)ceil((node_beta + mpc_t * m->sigma - m->b) / m->a);
+        if (bound < BETA && (sign > 0 ? test_at_least(P, O, current_depth, shallow, player, bound)
+                                      : test_at_most(P, O, current_depth, shallow, player, -bound)))
+        {
+            *score = sign > 0 ? beta : alpha;
+            return 1;
+        }
+
+        /* v_deep <= node_alpha is very likely */
+        bound = (int)floor((node_alpha - mpc_t * m->sigma - m->b) / m->a);
+        if (bound > ALPHA && (sign > 0 ? test_at_most(P, O, current_depth, shallow, player, bound)
+                                       : test_at_least(P, O, current_depth, shallow, player, -bound)))
+        {
+            *score = sign > 0 ? alpha : beta;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+    Null window tests on the fail-hard minimax: with the window
+    (bound - 1, bound) the result is >= bound exactly when the value is,
+    and with (bound, bound + 1) it is <= bound exactly when the value is.
+ */
+static int test_at_least(uint64_t P, uint64_t O, int current_depth, int shallow, int player, int bound)
+{
+    return minimax(P, O, current_depth, current_depth + shallow, player, bound - 1, bound) >= bound;
+}
+
+static int test_at_most(uint64_t P, uint64_t O, int current_depth, int shallow, int player, int bound)
+{
+    return minimax(P, O, current_depth, current_depth + shallow, player, bound, bound + 1) <= bound;
+}
+
+/**
+ * Function to load a parameter file written by mpc_save(). Entries not
+ * in the file are left unfitted.
+ *
+ * @param path
+ *
+ * @return SUCCESS or FAILURE
+ */
+int mpc_load(const char *path)
+{
+    FILE *in = fopen(path, "r");
+    char line[256];
+    int stage, depth, check;
+    double a, b, sigma;
+
+    if (in == NULL)
+        return FAILURE;
+    memset(mpc_table, 0, sizeof(mpc_table));
+    while (fgets(line, sizeof(line), in) != NULL)
+    {
+        if (line[0] == '#')
+            continue;
+        if (sscanf(line, "%d %d %d %lf %lf %lf", &stage, &depth, &check, &a, &b, &sigma) != 6)
+            continue;
+        if (stage < 0 || stage >= MPC_STAGES || depth < 0 || depth > MPC_MAXDEPTH ||
+            check < 0 || check >= MPC_CHECKS)
+            continue;
+        mpc_table[stage][depth][check].a = a;
+        mpc_table[stage][depth][check].b = b;
+        mpc_table[stage][depth][check].sigma = sigma;
+    }
+    fclose(in);
+    return SUCCESS;
+}
+
+/**
+ * Function to write the fitted parameters, one line per entry.
+ *
+ * @param path
+ *
+ * @return SUCCESS or FAILURE
+ */
+int mpc_save(const char *path)
+{
+    FILE *out = fopen(path, "w");
+    if (out == NULL)
+        return FAILURE;
+    fprintf(out, "# stage depth check a b sigma\n");
+    for (int stage = 0; stage < MPC_STAGES; stage++)
+        for (int depth = MPC_MINDEPTH; depth <= MPC_MAXDEPTH; depth++)
+            for (int check = 0; check < MPC_CHECKS; check++)
+            {
+                struct mpc_params *m = &mpc_table[stage][depth][check];
+                if (m->sigma > 0)
+                    fprintf(out, "%d %d %d %.6f %.6f %.6f\n", stage, depth, check, m->a, m->b, m->sigma);
+            }
+    fclose(out);
+    return SUCCESS;
+}
+
+/**
+ * Entry point for fitting, called on every rank. Each position is
+ * searched full width at every depth up to the given one, and the
+ * shallow and deep values of every (stage, depth, check) go into least
+ * squares sums. Positions are striped over the ranks and the sums are
+ * reduced on rank 0, which writes the parameter file.
+ *
+ * Usage: main --mpc-fit <params> [--positions file] [--count n] [--depth d]
+ *
+ * @param argc
+ * @param argv
+ *
+ * @return SUCCESS or FAILURE
+ */
+int mpc_fit_main(int argc, char *argv[])
+{
+    const char *positions = NULL;
+    int count = 2000, max_depth = 7;
+    int num_positions = 0;
+    struct batch_position *pos;
+    /* n, sum x, sum y, sum xx, sum xy, sum yy */
+    static double sums[MPC_STAGES][MPC_MAXDEPTH + 1][MPC_CHECKS][6];
+    static double totals[MPC_STAGES][MPC_MAXDEPTH + 1][MPC_CHECKS][6];
+    int values[MPC_MAXDEPTH + 1];
+
+    for (int i = 3; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--positions") == 0 && i + 1 < argc)
+            positions = argv[++i];
+        else if (strcmp(argv[i], "--count") == 0 && i + 1 < argc)
+            count = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--depth") == 0 && i + 1 < argc)
+            max_depth = atoi(argv[++i]);
+    }
+    if (max_depth > MPC_MAXDEPTH)
+        max_depth = MPC_MAXDEPTH;
+
+    pos = malloc(count * sizeof(struct batch_position));
+    if (positions != NULL)
+    {
+        FILE *in = fopen(positions, "r");
+        long line = 0;
+        if (in == NULL)
+        {
+            fprintf(stderr, "mpc: cannot open %s\n", positions);
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        while (num_positions < count && batch_read_position(in, 0, &pos[num_positions], &line))
+            num_positions++;
+        fclose(in);
+    }
+    else
+    {
+        bench_positions(pos, count, BENCH_SEED + 1, 8, 52);
+        num_positions = count;
+    }
+
+    /* the deep values must come from full width searches */
+    mpc_t = 0.0;
+    share_bounds = 0;
+    memset(sums, 0, sizeof(sums));
+    for (int i = rank; i < num_positions; i += size)
+    {
+        uint64_t P = pos[i].player == BLACK ? pos[i].black : pos[i].white;
+        uint64_t O = pos[i].player == BLACK ? pos[i].white : pos[i].black;
+        int stage = (64 - __builtin_popcountll(P | O)) / 10;
+
+        my_colour = pos[i].player;
+        for (int depth = 1; depth <= max_depth; depth++)
+            values[depth] = minimax(P, O, 0, depth, my_colour, ALPHA, BETA);
+
+        for (int depth = MPC_MINDEPTH; depth <= max_depth; depth++)
+            for (int check = 0; check < MPC_CHECKS; check++)
+            {
+                int shallow = mpc_check_depth(depth, check);
+                double x = values[shallow], y = values[depth];
+                double *s = sums[stage][depth][check];
+                if (shallow == 0)
+                    continue;
+                s[0] += 1;
+                s[1] += x;
+                s[2] += y;
+                s[3] += x * x;
+                s[4] += x * y;
+                s[5] += y * y;
+            }
+    }
+    MPI_Reduce(sums, totals, sizeof(sums) / sizeof(double), MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+    free(pos);
+    if (rank != 0)
+        return SUCCESS;
+
+    memset(mpc_table, 0, sizeof(mpc_table));
+    for (int stage = 0; stage < MPC_STAGES; stage++)
+        for (int depth = MPC_MINDEPTH; depth <= max_depth; depth++)
+            for (int check = 0; check < MPC_CHECKS; check++)
+            {
+                double *s = totals[stage][depth][check];
+                double n = s[0], sxx, sxy, syy, a, b, rss;
+                if (n < MPC_MINSAMPLES)
+                    continue;
+                sxx = s[3] - s[1] * s[1] / n;
+                sxy = s[4] - s[1] * s[2] / n;
+                syy = s[5] - s[2] * s[2] / n;
+                if (sxx <= 0)
+                    continue;
+                a = sxy / sxx;
+                b = (s[2] - a * s[1]) / n;
+                rss = syy - a * sxy;
+                mpc_table[stage][depth][check].a = a;
+                mpc_table[stage][depth][check].b = b;
+                mpc_table[stage][depth][check].sigma = sqrt(rss > 0 ? rss / (n - 2) : 0) + 1e-6;
+                printf("stage %d depth %2d shallow %d: n=%5.0f a=%.3f b=%7.3f sigma=%.3f\n", stage,
+                       depth, mpc_check_depth(depth, check), n, a, b,
+                       mpc_table[stage][depth][check].sigma);
+            }
+    if (mpc_save(argv[2]) == FAILURE)
+    {
+        fprintf(stderr, "mpc: cannot write %s\n", argv[2]);
+        return FAILURE;
+    }
+    return SUCCESS;
+}
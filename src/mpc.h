@@ -0,0 +1,39 @@
+#ifndef _MPC_H
+#define _MPC_H
+
+#include <stdint.h>
+
+/*
+    Multi-ProbCut. Before searching a node with MPC_MINDEPTH or more plies
+    left, up to MPC_CHECKS shallow searches predict the deep value with a
+    linear model v_deep = a * v_shallow + b whose residuals have standard
+    deviation sigma. If the prediction is beyond beta (or alpha) by more
+    than mpc_t sigmas the node is cut without the deep search.
+
+    The model is fitted per game stage (empties / 10) and per deep and
+    shallow depth. mpc_t is the selectivity: 0 turns MPC off, larger
+    values prune less.
+ */
+#define MPC_STAGES 7
+#define MPC_MAXDEPTH 12
+#define MPC_CHECKS 2
+#define MPC_MINDEPTH 3
+#define MPC_MINSAMPLES 30
+
+struct mpc_params
+{
+    double a, b, sigma; /* sigma 0: not fitted, never cut */
+};
+
+extern double mpc_t;
+extern struct mpc_params mpc_table[MPC_STAGES][MPC_MAXDEPTH + 1][MPC_CHECKS];
+
+void mpc_init();
+int mpc_check_depth(int depth, int check);
+int mpc_prune(uint64_t P, uint64_t O, int current_depth, int max_depth, int player,
+              int alpha, int beta, int *score);
+int mpc_load(const char *path);
+int mpc_save(const char *path);
+int mpc_fit_main(int argc, char *argv[]);
+
+#endif
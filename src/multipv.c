@@ -0,0 +1,327 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mpi.h>
+#include "comms.h"
+#include "player.h"
+#include "tables.h"
+#include "bitboard.h"
+#include "batch.h"
+#include "tt.h"
+#include "multipv.h"
+
+static int top = MULTIPV_TOP;
+static int pv_depth = MAX_DEPTH;
+static int fast = 0;
+
+static int analyse(const struct batch_position *pos, int n, FILE *out, int *best, long long *total);
+static int kth_score(const struct multipv_result *results, const int *exact, int count);
+static void search_task(const struct multipv_task *task, struct multipv_result *res);
+static void multipv_worker();
+static void write_square(FILE *out, int sq);
+
+/**
+ * Entry point for multi-PV analysis, called on every rank. Rank 0 reads
+ * the positions, writes the results and prints one line per position;
+ * the other ranks search root moves until it is done.
+ *
+ * Usage: main --multipv <positions> <results> [--top k] [--depth d] [--fast] [--binary]
+ *
+ * @param argc
+ * @param argv
+ *
+ * @return SUCCESS
+ */
+int multipv_main(int argc, char *argv[])
+{
+    int binary = 0;
+    struct batch_position pos;
+    long line = 0;
+    FILE *in, *out;
+
+    for (int i = 4; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--top") == 0 && i + 1 < argc)
+            top = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--depth") == 0 && i + 1 < argc)
+            pv_depth = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--fast") == 0)
+            fast = 1;
+        else if (strcmp(argv[i], "--binary") == 0)
+            binary = 1;
+    }
+    if (pv_depth < 1)
+        pv_depth = 1;
+    if (top < 0)
+        top = 0;
+    /* the root moves are searched independently, the window comes from rank 0 */
+    share_bounds = 0;
+    tt_cutoffs = fast;
+
+    if (rank != 0)
+    {
+        multipv_worker();
+        return SUCCESS;
+    }
+
+    in = fopen(argv[2], binary ? "rb" : "r");
+    out = fopen(argv[3], "w");
+    if (in == NULL || out == NULL)
+    {
+        fprintf(stderr, "multipv: cannot open %s\n", in == NULL ? argv[2] : argv[3]);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    if (size == 1 && tt_table == NULL && tt_init(0) == FAILURE)
+    {
+        fprintf(stderr, "multipv: cannot allocate the transposition table\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    double total = 0;
+    long long total_nodes = 0;
+    printf("multipv: %d ranks, depth %d, top %d%s%s\n", size, pv_depth, top, top == 0 ? " (all moves)" : "",
+           fast ? ", table cutoffs" : "");
+    printf("  #  moves  best  score         nodes      time\n");
+    for (int n = 1; batch_read_position(in, binary, &pos, &line); n++)
+    {
+        long long position_nodes = 0;
+        double start = MPI_Wtime();
+        int best, score = analyse(&pos, n, out, &best, &position_nodes);
+        double elapsed = MPI_Wtime() - start;
+
+        total += elapsed;
+        total_nodes += position_nodes;
+        printf("%3d  %5d  ", n, __builtin_popcountll(bb_moves(pos.player == BLACK ? pos.black : pos.white,
+                                                               pos.player == BLACK ? pos.white : pos.black)));
+        write_square(stdout, best);
+        printf("  %+5d  %12lld  %8.3fs\n", score, position_nodes, elapsed);
+        fflush(stdout);
+    }
+    printf("total                     %12lld  %8.3fs\n", total_nodes, total);
+    fclose(in);
+    fclose(out);
+
+    for (int i = 1; i < size; i++)
+        MPI_Send(NULL, 0, MPI_BYTE, i, MULTIPV_STOP, MPI_COMM_WORLD);
+    return SUCCESS;
+}
+
+/*
+    Searches every root move of one position with the workers, or alone
+    on a single rank, and writes the top moves. Returns the best score
+    and sets best to its move.
+ */
+static int analyse(const struct batch_position *pos, int n, FILE *out, int *best, long long *total)
+{
+    uint64_t P = pos->player == BLACK ? pos->black : pos->white;
+    uint64_t O = pos->player == BLACK ? pos->white : pos->black;
+    uint64_t legal = bb_moves(P, O), flips;
+    struct multipv_result results[MULTIPV_MAXMOVES];
+    struct multipv_task task;
+    int order[MULTIPV_MAXMOVES], order_score[MULTIPV_MAXMOVES], window[MULTIPV_MAXMOVES], exact[MULTIPV_MAXMOVES];
+    int count = 0, next = 0, pending = 0, found = 0;
+    int idle[size], num_idle = 0;
+
+    my_colour = pos->player;
+    nodes = 0;
+    if (legal == 0)
+    {
+        /* a pass is the only move, its score comes from the search below it */
+        int score = minimax(P, O, 0, pv_depth, my_colour, ALPHA, BETA);
+        fprintf(out, "%d pass %d\n", n, score);
+        *best = TT_NOMOVE;
+        *total = nodes;
+        return score;
+    }
+
+    /* best first by a shallow search, so the k-th best score rises early */
+    for (; legal; legal &= legal - 1)
+    {
+        int sq = __builtin_ctzll(legal), i = count++;
+        flips = bb_flips(P, O, sq);
+        order_score[i] = pv_depth > MULTIPV_ORDER
+                             ? iterative_minimax(O ^ flips, P ^ flips ^ (1ULL << sq), 1, MULTIPV_ORDER,
+                                                 OPPONENT[my_colour], ALPHA, BETA)
+                             : 0;
+        for (; i > 0 && order_score[i - 1] < order_score[i]; i--)
+        {
+            int s = order_score[i];
+            order_score[i] = order_score[i - 1];
+            order_score[i - 1] = s;
+            order[i] = order[i - 1];
+        }
+        order[i] = sq;
+    }
+    *total = nodes;
+
+    task.P = P;
+    task.O = O;
+    task.player = my_colour;
+    task.position = n;
+    task.depth = pv_depth;
+    memset(exact, 0, sizeof(exact));
+    for (int i = 1; i < size; i++)
+        idle[num_idle++] = i;
+    while (next < count || pending > 0)
+    {
+        struct multipv_result res;
+        MPI_Status status;
+
+        if (next < count && (num_idle > 0 || size == 1))
+        {
+            /* one below the k-th best exact score: moves that cannot make the top k fail low */
+            task.index = next;
+            task.move = order[next];
+            task.alpha = top > 0 && found >= top ? kth_score(results, exact, count) - 1 : ALPHA;
+            window[next++] = task.alpha;
+            if (size > 1)
+            {
+                MPI_Send(&task, sizeof(task), MPI_BYTE, idle[--num_idle], MULTIPV_TASK, MPI_COMM_WORLD);
+                pending++;
+                continue;
+            }
+            search_task(&task, &res);
+        }
+        else
+        {
+            MPI_Recv(&res, sizeof(res), MPI_BYTE, MPI_ANY_SOURCE, MULTIPV_RESULT, MPI_COMM_WORLD, &status);
+            idle[num_idle++] = status.MPI_SOURCE;
+            pending--;
+        }
+        results[res.index] = res;
+        *total += res.nodes;
+        /* fail hard: anything above the window is exact */
+        exact[res.index] = window[res.index] == ALPHA || res.score > window[res.index];
+        found += exact[res.index];
+    }
+
+    /* exact scores best first, ties in search order */
+    int reported = 0, best_score = ALPHA;
+    while (top == 0 || reported < top)
+    {
+        int pick = -1;
+        for (int i = 0; i < count; i++)
+        {
+            if (exact[i] && (pick == -1 || results[i].score > results[pick].score))
+                pick = i;
+        }
+        if (pick == -1)
+            break;
+        exact[pick] = 0;
+        if (reported++ == 0)
+        {
+            *best = order[pick];
+            best_score = results[pick].score;
+        }
+        fprintf(out, "%d ", n);
+        write_square(out, order[pick]);
+        fprintf(out, " %d", results[pick].score);
+        for (int i = 0; i < results[pick].pv_length; i++)
+        {
+            fputc(' ', out);
+            write_square(out, results[pick].pv[i]);
+        }
+        fputc('\n', out);
+    }
+    return best_score;
+}
+
+/*
+    The k-th best of the exact scores, there being at least k of them
+ */
+static int kth_score(const struct multipv_result *results, const int *exact, int count)
+{
+    int kth = BETA;
+
+    for (int i = 0; i < count; i++)
+    {
+        int better = 0;
+        if (!exact[i])
+            continue;
+        for (int j = 0; j < count; j++)
+            better += exact[j] && results[j].score > results[i].score;
+        if (better < top && results[i].score < kth)
+            kth = results[i].score;
+    }
+    return kth;
+}
+
+/*
+    Searches one root move with the task's window and reads its principal
+    variation back from the table
+ */
+static void search_task(const struct multipv_task *task, struct multipv_result *res)
+{
+    static int position = 0;
+    uint64_t flips = bb_flips(task->P, task->O, task->move);
+    uint64_t P = task->O ^ flips, O = task->P ^ flips ^ (1ULL << task->move), legal;
+    int mine = 0, score, move;
+
+    if (task->position != position)
+    {
+        position = task->position;
+        tt_new_search();
+    }
+    my_colour = task->player;
+    nodes = 0;
+    res->index = task->index;
+    res->score = iterative_minimax(P, O, 1, task->depth, OPPONENT[my_colour], task->alpha, BETA);
+    res->nodes = nodes;
+
+    res->pv[0] = task->move;
+    res->pv_length = 1;
+    while (res->pv_length < MULTIPV_MAXPV && res->pv_length < task->depth)
+    {
+        legal = bb_moves(P, O);
+        if (legal == 0)
+        {
+            if (bb_moves(O, P) == 0)
+                break;
+            move = TT_NOMOVE;
+        }
+        else
+        {
+            /* deeper than any entry, so the probe only reports the move */
+            tt_probe(tt_hash(P, O, mine), MULTIPV_MAXPV + 64, ALPHA, BETA, &score, &move);
+            if (move == TT_NOMOVE || !(legal & (1ULL << move)))
+                break;
+            flips = bb_flips(P, O, move);
+            P ^= flips | (1ULL << move);
+            O ^= flips;
+        }
+        res->pv[res->pv_length++] = move;
+        uint64_t t = P;
+        P = O;
+        O = t;
+        mine = !mine;
+    }
+}
+
+static void multipv_worker()
+{
+    struct multipv_task task;
+    struct multipv_result res;
+    MPI_Status status;
+
+    if (tt_table == NULL && tt_init(0) == FAILURE)
+    {
+        fprintf(stderr, "worker %d: cannot allocate the transposition table\n", rank);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    while (1)
+    {
+        MPI_Recv(&task, sizeof(task), MPI_BYTE, 0, MPI_ANY_TAG, MPI_COMM_WORLD, &status);
+        if (status.MPI_TAG == MULTIPV_STOP)
+            break;
+        search_task(&task, &res);
+        MPI_Send(&res, sizeof(res), MPI_BYTE, 0, MULTIPV_RESULT, MPI_COMM_WORLD);
+    }
+}
+
+static void write_square(FILE *out, int sq)
+{
+    if (sq == TT_NOMOVE)
+        fputs("pass", out);
+    else
+        fprintf(out, "%d%d", sq / 8, sq % 8);
+}
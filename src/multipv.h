@@ -0,0 +1,63 @@
+#ifndef _MULTIPV_H
+#define _MULTIPV_H
+
+#include <stdint.h>
+
+/*
+    Multi-PV root analysis: scores and principal variations for the best
+    k root moves of each position (every move with --top 0) from one
+    parallel search, rather than a search per move.
+        main --multipv <positions> <results> [--top k] [--depth d] [--fast] [--binary]
+    Positions are read like --batch input. Rank 0 orders the root moves
+    with a MULTIPV_ORDER ply search, then hands them out best first, one
+    to each free worker, with the window as it stands: alpha is one
+    below the k-th best exact score found so far, so a move that cannot
+    reach the top k fails low cheaply, and one that can is searched with
+    a window wide enough to give its exact score. With --top 0 every
+    move gets the full window. A worker returns the score and the
+    principal variation, read from its transposition table.
+
+    The table orders the moves and holds the principal variation, but
+    its entries never cut the search (tt_cutoffs is 0), so every score
+    is the fixed depth value whichever worker searched the move, and the
+    top k agree with the --top 0 list. --fast lets entries from deeper or
+    earlier searches cut it as in a game: faster, but a score can then be
+    a few points off and near ties can change places in the top k.
+
+    Results have a line per reported move, best first:
+        <position> <move> <score> <pv moves...>
+    moves written "rc" (row and column digits) or "pass", scores from
+    the side to move's view.
+ */
+#define MULTIPV_TOP 1
+#define MULTIPV_ORDER 2
+#define MULTIPV_MAXPV 32
+#define MULTIPV_MAXMOVES 64 /* root moves, more than any position has */
+#define MULTIPV_TASK 40
+#define MULTIPV_RESULT 41
+#define MULTIPV_STOP 42
+
+struct multipv_task
+{
+    uint64_t P; /* root position, P to move */
+    uint64_t O;
+    int player;   /* colour of P */
+    int position; /* the worker starts a table generation when it changes */
+    int index;    /* root move being searched */
+    int move;     /* its square, bit 0 = a1 */
+    int depth;
+    int alpha;
+};
+
+struct multipv_result
+{
+    int index;
+    int score;
+    long long nodes;
+    int pv_length;
+    int pv[MULTIPV_MAXPV]; /* squares, TT_NOMOVE for a pass */
+};
+
+int multipv_main(int argc, char *argv[]);
+
+#endif
@@ -0,0 +1,17 @@
+#include <stdint.h>
+#include "player.h"
+#include "tables.h"
+#include "bitboard.h"
+#include "evaluate.h"
+#include "mpc.h"
+#include "tt.h"
+#include "lazy.h"
+#include "negamax.h"
+
+#define SIDE_MINE 1
+#include "negamax_side.h"
+#undef SIDE_MINE
+
+#define SIDE_MINE 0
+#include "negamax_side.h"
+#undef SIDE_MINE
@@ -0,0 +1,18 @@
+#ifndef _NEGAMAX_H
+#define _NEGAMAX_H
+
+#include <stdint.h>
+
+/*
+    Negamax search kernel behind minimax(). There is one copy of the
+    search per side to move, generated from negamax_side.h: negamax_mine
+    for nodes where my_colour is to move, negamax_theirs for the others.
+    Both take and return scores from the side to move's view, so
+    minimax(..., player, alpha, beta) is
+        negamax_mine(..., alpha, beta)        player == my_colour
+        -negamax_theirs(..., -beta, -alpha)   otherwise
+ */
+int negamax_mine(uint64_t P, uint64_t O, int current_depth, int max_depth, int alpha, int beta);
+int negamax_theirs(uint64_t P, uint64_t O, int current_depth, int max_depth, int alpha, int beta);
+
+#endif
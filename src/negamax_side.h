@@ -0,0 +1,164 @@
+/*
+    One side of the negamax kernel, included twice by negamax.c (so no
+    include guard): with SIDE_MINE 1 for nodes where my_colour is to
+    move and with SIDE_MINE 0 for nodes where its opponent is. Each
+    instantiation calls the other for the children, so which side is to
+    move is known at compile time and never tested in the search.
+
+    Scores and windows inside are from the side to move's view. The
+    evaluation, the table, Multi-ProbCut and the shared bounds keep
+    my_colour's view, so VIEW() and the window macros convert at those
+    calls only. The search is otherwise the fail-hard minimax it
+    replaces, node for node.
+ */
+#if SIDE_MINE
+#define NEGAMAX negamax_mine
+#define NEGAMAX_CHILD negamax_theirs
+#define FRONTIER frontier_mine
+#define SIDE_PLAYER my_colour
+#define VIEW(score) (score)
+#define VIEW_ALPHA(alpha, beta) (alpha)
+#define VIEW_BETA(alpha, beta) (beta)
+#define LEAF(P, O) evaluate_board(P, O)
+#else
+#define NEGAMAX negamax_theirs
+#define NEGAMAX_CHILD negamax_mine
+#define FRONTIER frontier_theirs
+#define SIDE_PLAYER OPPONENT[my_colour]
+#define VIEW(score) (-(score))
+#define VIEW_ALPHA(alpha, beta) (-(beta))
+#define VIEW_BETA(alpha, beta) (-(alpha))
+#define LEAF(P, O) (-evaluate_board(O, P))
+#endif
+
+/*
+    Finishes a depth-1 node. Children are generated and scored with
+    evaluate_batch() a group at a time, one group being as many
+    positions as the evaluation kernel scores in a single pass, then
+    folded in move order. A cutoff stops before the next group is built.
+ */
+static int FRONTIER(uint64_t P, uint64_t O, uint64_t legal, int current_depth, int alpha, int beta)
+{
+    uint64_t mine[EVAL_BATCHSIZE], theirs[EVAL_BATCHSIZE], flips;
+    int scores[EVAL_BATCHSIZE];
+    int n, sq, score;
+    int group = evaluate_batch_width();
+
+    while (legal)
+    {
+        for (n = 0; n < group && legal; n++, legal &= legal - 1)
+        {
+            sq = __builtin_ctzll(legal);
+            flips = bb_flips(P, O, sq);
+#if SIDE_MINE
+            mine[n] = P ^ flips ^ (1ULL << sq);
+            theirs[n] = O ^ flips;
+#else
+            mine[n] = O ^ flips;
+            theirs[n] = P ^ flips ^ (1ULL << sq);
+#endif
+        }
+        evaluate_batch(mine, theirs, n, scores);
+
+        for (int i = 0; i < n; i++)
+        {
+            nodes++;
+            score = VIEW(scores[i]);
+            if (score > alpha)
+                alpha = score;
+            if (alpha > beta)
+            {
+                if (share_bounds && current_depth < 2)
+                    alpha_beta_sharing(VIEW_ALPHA(alpha, beta), VIEW_BETA(alpha, beta));
+                return alpha;
+            }
+        }
+    }
+    return alpha;
+}
+
+int NEGAMAX(uint64_t P, uint64_t O, int current_depth, int max_depth, int alpha, int beta)
+{
+    uint64_t legal, flips, key = 0;
+    int sq, score;
+    int depth = max_depth - current_depth;
+    int hash_move = TT_NOMOVE, best_move = TT_NOMOVE;
+    int alpha0 = alpha, beta0 = beta;
+
+    nodes++;
+    if (lazy_active && (nodes & LAZY_POLL) == 0)
+        lazy_poll();
+    if (search_stopped)
+        return alpha;
+    if (current_depth >= max_depth)
+        return LEAF(P, O);
+
+    if (tt_table != NULL && depth >= TT_MINDEPTH)
+    {
+        key = tt_hash(P, O, SIDE_MINE);
+        if (tt_probe(key, depth, VIEW_ALPHA(alpha, beta), VIEW_BETA(alpha, beta), &score, &hash_move))
+            return VIEW(score);
+    }
+    legal = bb_moves(P, O);
+
+    if (legal == 0)
+    {
+        /* game over if neither side can move, otherwise pass */
+        if (bb_moves(O, P) == 0)
+            return LEAF(P, O);
+        return -NEGAMAX_CHILD(O, P, current_depth + 1, max_depth, -beta, -alpha);
+    }
+
+    /* Multi-ProbCut: skip the deep search if shallow ones say it cannot matter */
+    if (mpc_t > 0 && depth >= MPC_MINDEPTH &&
+        mpc_prune(P, O, current_depth, max_depth, SIDE_PLAYER, VIEW_ALPHA(alpha, beta), VIEW_BETA(alpha, beta),
+                  &score))
+        return VIEW(score);
+
+    /* children are leaves: build them all and score them in one batch */
+    if (current_depth + 1 >= max_depth)
+        return FRONTIER(P, O, legal, current_depth, alpha, beta);
+
+    /* the table's best move first, then square order */
+    if (hash_move != TT_NOMOVE && !(legal & (1ULL << hash_move)))
+        hash_move = TT_NOMOVE;
+    while (legal)
+    {
+        sq = hash_move != TT_NOMOVE ? hash_move : __builtin_ctzll(legal);
+        hash_move = TT_NOMOVE;
+        legal &= ~(1ULL << sq);
+        flips = bb_flips(P, O, sq);
+        score = -NEGAMAX_CHILD(O ^ flips, P ^ flips ^ (1ULL << sq), current_depth + 1, max_depth, -beta, -alpha);
+        if (score > alpha || best_move == TT_NOMOVE)
+            best_move = sq;
+        if (score > alpha)
+            alpha = score;
+        if (alpha > beta)
+        {
+            if (share_bounds && current_depth < 2)
+                alpha_beta_sharing(VIEW_ALPHA(alpha, beta), VIEW_BETA(alpha, beta));
+            break;
+        }
+    }
+
+    /* the table keeps my_colour's view, bounds and all */
+    if (key != 0 && !search_stopped)
+    {
+        score = VIEW(alpha);
+        tt_store(key, depth, score,
+                 score <= VIEW_ALPHA(alpha0, beta0)  ? TT_UPPER
+                 : score >= VIEW_BETA(alpha0, beta0) ? TT_LOWER
+                                                     : TT_EXACT,
+                 best_move);
+    }
+    return alpha;
+}
+
+#undef NEGAMAX
+#undef NEGAMAX_CHILD
+#undef FRONTIER
+#undef SIDE_PLAYER
+#undef VIEW
+#undef VIEW_ALPHA
+#undef VIEW_BETA
+#undef LEAF
@@ -0,0 +1,132 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mpi.h>
+#include "comms.h"
+#include "player.h"
+#include "perft.h"
+#include "bitboard.h"
+
+/* leaf counts from the initial position, depth 1 to 12 */
+static const long long perft_known[] = {1, 4, 12, 56, 244, 1396, 8200, 55092, 390216,
+                                        3005288, 24571284, 212258800, 1939886636};
+
+static const char *perft_names[3] = {"mailbox", "scalar", "avx2"};
+
+/**
+ * Entry point for perft, only rank 0 does any work. Every depth is run
+ * with the mailbox generator and with each bitboard kernel the CPU
+ * supports, so their speeds can be compared directly.
+ *
+ * @param argc
+ * @param argv
+ *
+ * @return SUCCESS, or FAILURE if a count does not match
+ */
+int perft_main(int argc, char *argv[])
+{
+    int max_depth = atoi(argv[2]);
+    int result = SUCCESS;
+    int kernel = bb_kernel;
+    int impls = bb_avx2_supported() ? 3 : 2;
+
+    if (rank != 0)
+        return SUCCESS;
+
+    for (int depth = 1; depth <= max_depth; depth++)
+    {
+        for (int impl = 0; impl < impls; impl++)
+        {
+            long long leaves;
+            double start = MPI_Wtime();
+            if (impl == 0)
+                leaves = perft(depth, BLACK, 0);
+            else
+            {
+                uint64_t P, O;
+                bb_init(impl == 1 ? BB_SCALAR : BB_AVX2);
+                bb_from_board(board, BLACK, &P, &O);
+                leaves = perft_bb(P, O, depth, 0);
+            }
+            double elapsed = MPI_Wtime() - start;
+            int known = depth < (int)(sizeof(perft_known) / sizeof(perft_known[0]));
+
+            printf("perft %2d %-7s %12lld %9.3fs %8.2f Mnps %s\n", depth, perft_names[impl],
+                   leaves, elapsed, elapsed > 0 ? leaves / elapsed / 1e6 : 0.0,
+                   !known ? "" : leaves == perft_known[depth] ? "ok" : "MISMATCH");
+            if (known && leaves != perft_known[depth])
+                result = FAILURE;
+        }
+    }
+    bb_init(kernel);
+    return result;
+}
+
+/**
+ * Function to count the leaves below the global board. A pass counts as
+ * a ply, two passes in a row end the game.
+ *
+ * @param depth
+ * @param player  side to move
+ * @param passed  1 if the previous ply was a pass
+ *
+ * @return number of leaves
+ */
+long long perft(int depth, int player, int passed)
+{
+    int list[LEGALMOVSBUFSIZE];
+    int saved[BOARDSIZE];
+    long long leaves = 0;
+
+    memcpy(list, legalmoves(player), LEGALMOVSBUFSIZE * sizeof(int));
+    if (list[0] == 0)
+    {
+        if (passed || depth == 1)
+            return 1;
+        return perft(depth - 1, opponent(player), 1);
+    }
+    if (depth == 1)
+        return list[0];
+
+    memcpy(saved, board, BOARDSIZE * sizeof(int));
+    for (int i = 1; i <= list[0]; i++)
+    {
+        makemove(list[i], player);
+        leaves += perft(depth - 1, opponent(player), 0);
+        memcpy(board, saved, BOARDSIZE * sizeof(int));
+    }
+    return leaves;
+}
+
+/**
+ * Function to count leaves with the bitboard kernels.
+ *
+ * @param P       side to move
+ * @param O
+ * @param depth
+ * @param passed  1 if the previous ply was a pass
+ *
+ * @return number of leaves
+ */
+long long perft_bb(uint64_t P, uint64_t O, int depth, int passed)
+{
+    uint64_t legal = bb_moves(P, O);
+    long long leaves = 0;
+
+    if (legal == 0)
+    {
+        if (passed || depth == 1)
+            return 1;
+        return perft_bb(O, P, depth - 1, 1);
+    }
+    if (depth == 1)
+        return __builtin_popcountll(legal);
+
+    for (; legal; legal &= legal - 1)
+    {
+        int sq = __builtin_ctzll(legal);
+        uint64_t flips = bb_flips(P, O, sq);
+        leaves += perft_bb(O ^ flips, P ^ flips ^ (1ULL << sq), depth - 1, 0);
+    }
+    return leaves;
+}
@@ -0,0 +1,17 @@
+#ifndef _PERFT_H
+#define _PERFT_H
+
+#include <stdint.h>
+
+/*
+    Perft: counts the leaf nodes of the full game tree to a fixed depth
+    from the initial position. Used to check move generation and
+    makemove() against the known counts and to time them, and the
+    bitboard kernels against each other.
+        main --perft <depth>
+ */
+int perft_main(int argc, char *argv[]);
+long long perft(int depth, int player, int passed);
+long long perft_bb(uint64_t P, uint64_t O, int depth, int passed);
+
+#endif
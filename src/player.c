@@ -7,12 +7,30 @@
 #include <time.h>
 #include <assert.h>
 #include "comms.h"
-
-/* minimax algo */
-#define MAX_DEPTH 5
-#define ALPHA -1000
-#define BETA 1000
-#define MAX_INT 1000
+#include "player.h"
+#include "batch.h"
+#include "gamelog.h"
+#include "perft.h"
+#include "tables.h"
+#include "bitboard.h"
+#include "evaluate.h"
+#include "mpc.h"
+#include "bench.h"
+#include "tune.h"
+#include "endgame.h"
+#include "tt.h"
+#include "lazy.h"
+#include "mcts.h"
+#include "selfplay.h"
+#include "server.h"
+#include "local_referee.h"
+#include "arena.h"
+#include "topology.h"
+#include "negamax.h"
+#include "multipv.h"
+#include "trace.h"
+#include "gamedb.h"
+#include "journal.h"
 
 const int OUTER = 3;
 const int ALLDIRECTIONS[8] = {-11, -10, -9, -1, 1, 9, 10, 11};
@@ -21,46 +39,26 @@ const int LEGALMOVSBUFSIZE = 65;
 const char piecenames[4] = {'.', 'b', 'w', '?'};
 const int SHARE = 1;
 
-int *gen_move(char *move);
-void play_move(char *move);
-void game_over();
-void run_worker();
-void initialise_board();
-void free_board();
-
-int *legalmoves(int player);
-int legalp(int move, int player);
-int validp(int move);
-int wouldflip(int move, int dir, int player);
-int opponent(int player);
-int findbracketingpiece(int square, int dir, int player);
-int randomstrategy();
-void makemove(int move, int player);
-void makeflips(int move, int dir, int player);
-int get_loc(char *movestring);
-void get_move_string(int loc, char *ms);
-void printboard();
-char nameof(int piece);
-int count(int player, int *board);
-void divide_moves(int *global_moves, int *local_moves);
-void sort_moves(int player);
-int iterative_minimax(int *board, int current_depth, int max_depth, int player, int alpha, int beta);
-int minimax(int *board, int current_depth, int max_depth, int player, int alpha, int beta);
-int evaluate_board(int *board, int player);
-int *copy_board(int *board);
-void alpha_beta_sharing(int alpha, int beta);
-void print_process_moves(int *local_moves, int *send_counts); /* DEBUG */
-
 int my_colour;
 int time_limit;
 int running;
 int rank;
 int size;
 int *board;
-FILE *fp;
+struct gamelog game_log;
 int *moves;
 int *local_moves;
 int *send_counts, *displacements; /* dividing moves */
+static int *process_counts, *process_displacements;
+int share_bounds = 1;
+int search_mode = SEARCH_SPLIT;
+int search_depth = MAX_DEPTH;
+int search_stopped = 0;
+static const char *snapshot_path = NULL;
+static const char *trace_path = NULL;
+static const char *journal_path = NULL;
+long long nodes = 0;
+double search_busy = 0;
 /* weights for evaluation funciton */
 int weights[100] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
                     0, 20, 0, 10, 10, 10, 10, 0, 20, 0,
@@ -84,47 +82,246 @@ int main(int argc, char *argv[])
     char my_move[MOVEBUFSIZE];
 
     double start, end; /* timing */
-
-    /* starts MPI */
-    MPI_Init(&argc, &argv);
+    double move_start, wait;
+    int ply = 0;
+    struct gamedb_game record;
+    uint64_t black, white;
+    int provided;
+
+    /* starts MPI, the game log writer thread never calls MPI */
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
     start = MPI_Wtime();
     MPI_Comm_rank(MPI_COMM_WORLD, &rank); /* get current process id */
     MPI_Comm_size(MPI_COMM_WORLD, &size); /* get number of processes */
     my_colour = EMPTY;
     initialise_board();
+
+    /* move generation kernel: AVX2 if the CPU has it unless overridden */
+    bb_init(BB_AUTO);
+    mpc_init();
+    const char *weights_file = NULL;
+    for (int i = 1; i < argc - 1; i++)
+    {
+        if (strcmp(argv[i], "--kernel") == 0)
+            bb_init(bb_kernel_from_name(argv[i + 1]));
+        else if (strcmp(argv[i], "--mpc") == 0)
+            mpc_t = atof(argv[i + 1]);
+        else if (strcmp(argv[i], "--mpc-params") == 0 && mpc_load(argv[i + 1]) == FAILURE && rank == 0)
+            fprintf(stderr, "mpc: cannot read %s, using the built in parameters\n", argv[i + 1]);
+        else if (strcmp(argv[i], "--weights") == 0)
+            weights_file = argv[i + 1];
+        else if (strcmp(argv[i], "--search") == 0)
+            search_mode = strcmp(argv[i + 1], "lazy") == 0   ? SEARCH_LAZY
+                          : strcmp(argv[i + 1], "mcts") == 0 ? SEARCH_MCTS
+                                                             : SEARCH_SPLIT;
+        else if (strcmp(argv[i], "--threads") == 0)
+            mcts_threads = atoi(argv[i + 1]) > 0 ? atoi(argv[i + 1]) : 1;
+        else if (strcmp(argv[i], "--mcts-time") == 0)
+            mcts_time = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--lazy-grace") == 0)
+            lazy_grace = atof(argv[i + 1]);
+        else if (strcmp(argv[i], "--snapshot") == 0)
+            snapshot_path = argv[i + 1];
+        else if (strcmp(argv[i], "--trace") == 0)
+            trace_path = argv[i + 1];
+        else if (strcmp(argv[i], "--record") == 0)
+            gamedb_path = argv[i + 1];
+        else if (strcmp(argv[i], "--journal") == 0)
+            journal_path = argv[i + 1];
+        else if (strcmp(argv[i], "--pin") == 0 && (topology_pin = topology_mode_from_name(argv[i + 1])) == FAILURE)
+        {
+            topology_pin = TOPO_NONE;
+            if (rank == 0)
+                fprintf(stderr, "pin: %s is not compact, scatter or none\n", argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "--eval") == 0 && evaluate_parse_coef(argv[i + 1], eval_coef) == FAILURE &&
+                 rank == 0)
+            fprintf(stderr, "eval: coefficients are written m,s,f, not %s\n", argv[i + 1]);
+    }
+    /* tuned weights replace the hand set ones only when asked for */
+    if (weights_file != NULL && evaluate_load(weights_file) == FAILURE && rank == 0)
+        fprintf(stderr, "eval: %s is not a weights file for --eval %d,%d,%d, using the built in weights\n",
+                weights_file, eval_coef[EVAL_MOBILITY], eval_coef[EVAL_STABILITY], eval_coef[EVAL_FRONTIER]);
+    evaluate_init();
+
+    /* pinned before any table is touched, so its pages are local */
+    topology_init(search_mode == SEARCH_MCTS ? mcts_threads : 1);
+    trace_init(trace_path);
+    journal_init(journal_path, snapshot_path != NULL);
+
+    /* lazy SMP workers only talk through a table shared on each node */
+    if (search_mode == SEARCH_LAZY)
+    {
+        share_bounds = 0;
+        if (tt_init(1) == FAILURE)
+        {
+            fprintf(stderr, "lazy: cannot allocate the shared table\n");
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+    /* deep results of earlier games, probed after the live table */
+    if (snapshot_path != NULL)
+        tt_snapshot_map(snapshot_path);
     MPI_Status status;
 
+    /* the buffers below last the whole run */
+    if (arena_init(2 * ARENA_ROUND(LEGALMOVSBUFSIZE * sizeof(int)) + 4 * ARENA_ROUND((size + 1) * sizeof(int))) ==
+        FAILURE)
+    {
+        fprintf(stderr, "arena: cannot allocate\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
     /* array of valid moves */
-    moves = (int *)malloc(LEGALMOVSBUFSIZE * sizeof(int));
-    memset(moves, 0, LEGALMOVSBUFSIZE);
-    local_moves = (int *)malloc(LEGALMOVSBUFSIZE * sizeof(int));
-    memset(local_moves, 0, LEGALMOVSBUFSIZE);
+    moves = arena_alloc(LEGALMOVSBUFSIZE * sizeof(int));
+    memset(moves, 0, LEGALMOVSBUFSIZE * sizeof(int));
+    local_moves = arena_alloc(LEGALMOVSBUFSIZE * sizeof(int));
+    memset(local_moves, 0, LEGALMOVSBUFSIZE * sizeof(int));
 
     /* arrays for Scatterv function */
-    send_counts = (int *)malloc(size * sizeof(int));
-    memset(send_counts, 0, size);
-    displacements = (int *)malloc(size * sizeof(int));
-    memset(displacements, 0, size);
+    send_counts = arena_alloc(size * sizeof(int));
+    memset(send_counts, 0, size * sizeof(int));
+    displacements = arena_alloc(size * sizeof(int));
+    memset(displacements, 0, size * sizeof(int));
+
+    /* the workers' share of the root moves */
+    process_counts = arena_alloc((size + 1) * sizeof(int));
+    memset(process_counts, 0, (size + 1) * sizeof(int));
+    process_displacements = arena_alloc((size + 1) * sizeof(int));
+    memset(process_displacements, 0, (size + 1) * sizeof(int));
+    /* what a search rank holds for the whole run: the arena and either
+       the transposition table (one per node for lazy SMP) or the tree */
+    if (rank == 0)
+    {
+        size_t table = ((size_t)1 << TT_BITS) * sizeof(struct tt_entry);
+        size_t tree = (size_t)MCTS_NODES * sizeof(struct mcts_node);
+        if (search_mode == SEARCH_MCTS)
+            fprintf(stderr, "memory: %zu bytes per rank, arena %zu and tree %zu\n", arena_size() + tree,
+                    arena_size(), tree);
+        else if (search_mode == SEARCH_LAZY)
+            fprintf(stderr, "memory: %zu bytes per node for the table, %zu per rank for the arena\n", table,
+                    arena_size());
+        else
+            fprintf(stderr, "memory: %zu bytes per worker rank, arena %zu and table %zu\n", arena_size() + table,
+                    arena_size(), table);
+    }
+
+    if (argc >= 3 && strcmp(argv[1], "--perft") == 0)
+    {
+        int result = perft_main(argc, argv);
+        game_over();
+        return result == SUCCESS ? 0 : 1;
+    }
+
+    if (argc >= 4 && strcmp(argv[1], "--train") == 0)
+    {
+        int result = tune_main(argc, argv);
+        game_over();
+        return result == SUCCESS ? 0 : 1;
+    }
+
+    if (argc >= 3 && strcmp(argv[1], "--solve") == 0)
+    {
+        int result = endgame_main(argc, argv);
+        game_over();
+        return result == SUCCESS ? 0 : 1;
+    }
+
+    if (argc >= 3 && strcmp(argv[1], "--mpc-fit") == 0)
+    {
+        int result = mpc_fit_main(argc, argv);
+        game_over();
+        return result == SUCCESS ? 0 : 1;
+    }
+
+    if (argc >= 2 && strcmp(argv[1], "--bench") == 0)
+    {
+        int result = bench_main(argc, argv);
+        game_over();
+        return result == SUCCESS ? 0 : 1;
+    }
+
+    if (argc >= 2 && strcmp(argv[1], "--selfplay") == 0)
+    {
+        int result = selfplay_main(argc, argv);
+        game_over();
+        return result == SUCCESS ? 0 : 1;
+    }
+
+    if (argc >= 3 && strcmp(argv[1], "--serve") == 0)
+    {
+        int result = server_main(argc, argv);
+        game_over();
+        return result == SUCCESS ? 0 : 1;
+    }
+
+    if (argc >= 3 && strcmp(argv[1], "--referee") == 0)
+    {
+        int result = local_referee_main(argc, argv);
+        game_over();
+        return result == SUCCESS ? 0 : 1;
+    }
+
+    if (argc >= 3 && strcmp(argv[1], "--replay") == 0)
+    {
+        int result = journal_replay_main(argc, argv);
+        game_over();
+        return result == SUCCESS ? 0 : 1;
+    }
+
+    if (argc >= 4 && strcmp(argv[1], "--gamedb") == 0)
+    {
+        int result = gamedb_main(argc, argv);
+        game_over();
+        return result == SUCCESS ? 0 : 1;
+    }
+
+    if (argc >= 4 && strcmp(argv[1], "--multipv") == 0)
+    {
+        int result = multipv_main(argc, argv);
+        game_over();
+        return result == SUCCESS ? 0 : 1;
+    }
+
+    /* batch analysis replaces the game loop on every rank */
+    if (argc >= 4 && strcmp(argv[1], "--batch") == 0)
+    {
+        batch_main(argc, argv);
+        game_over();
+        return 0;
+    }
 
     /* Rank 0 is responsible for handling communication with the server */
-    if (rank == 0 && argc == 3)
+    if (rank == 0 && argc >= 3)
     {
         time_limit = atoi(argv[1]);
-        fp = fopen(argv[2], "w");
-        fprintf(fp, "This is an example of output written to file.\n");
-        fflush(fp);
+        for (int i = 3; i < argc; i++)
+        {
+            if (strcmp(argv[i], "-v") == 0)
+                gamelog_verbose = 1;
+        }
+        if (gamelog_open(&game_log, argv[2]) == FAILURE)
+            return FAILURE;
 
         if (comms_init(&my_colour) == FAILURE)
             return FAILURE;
         running = 1;
+        bb_from_board(board, BLACK, &black, &white);
+        gamedb_start(&record, black, white, BLACK, GAMEDB_MATCH);
+        record.h.engine = my_colour;
+        record.h.time_ms = time_limit * 1000;
+        record.h.depth[my_colour - 1] = search_depth;
 
-        MPI_Bcast(&running, 1, MPI_INT, 0, MPI_COMM_WORLD);
         while (running == 1)
         {
-            if (comms_get_cmd(cmd, opponent_move) == FAILURE)
+            TRACE_BEGIN(TRACE_REFEREE, ply);
+            wait = MPI_Wtime();
+            int got = comms_get_cmd(cmd, opponent_move);
+            wait = MPI_Wtime() - wait;
+            TRACE_END(TRACE_REFEREE, ply);
+            if (got == FAILURE)
             {
-                fprintf(fp, "Error getting cmd\n");
-                fflush(fp);
+                gamelog_message(&game_log, "Error getting cmd");
                 running = 0;
                 break;
             }
@@ -132,66 +329,58 @@ int main(int argc, char *argv[])
             if (strcmp(cmd, "game_over") == 0)
             {
                 running = 0;
-                fprintf(fp, "Game over\n");
-                fflush(fp);
+                gamelog_message(&game_log, "Game over");
+                if (gamedb_path != NULL)
+                    gamedb_append(gamedb_path, &record);
                 break;
 
                 /* Rank 0 calls gen_move */
             }
             else if (strcmp(cmd, "gen_move") == 0)
             {
-                MPI_Bcast(&running, 1, MPI_INT, 0, MPI_COMM_WORLD);
-                MPI_Bcast(&my_colour, 1, MPI_INT, 0, MPI_COMM_WORLD);
                 memset(my_move, 0, MOVEBUFSIZE);
                 strncpy(my_move, "pass\n", MOVEBUFSIZE);
-                int best_move = 0;
-                int temp_move = 0;
-                int temp_score = 0;
-                int score = -1000;
-
-                /* send current board state to processes */
-                for (int i = 1; i < size; i++)
+                int score;
+                move_start = MPI_Wtime();
+                TRACE_BEGIN(TRACE_MOVE, ply + 1);
+                int temp_move = parallel_search(&score);
+                if (temp_move > -1)
                 {
-                    MPI_Send(board, BOARDSIZE, MPI_INT, i, COMPUTE, MPI_COMM_WORLD);
+                    get_move_string(temp_move, my_move);
+                    makemove(temp_move, my_colour);
                 }
-                /* get legal moves & calculate displacements and moves per process */
-                legalmoves(my_colour);
-                divide_moves(moves, local_moves);
-
-#ifdef DEBUG
-                print_process_moves(local_moves, send_counts);
-#endif
-                /* get the best move from each process and compare */
-                for (int i = 1; i < size; i++)
-                {
-                    MPI_Recv(&best_move, 1, MPI_INT, i, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-                    MPI_Recv(&temp_score, 1, MPI_INT, i, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-                    if (temp_score > score)
-                    {
-                        temp_move = best_move;
-                        score = temp_score;
-                    }
-                }
-                get_move_string(best_move, my_move);
 #ifdef DEBUG
                 printf("Chosen move: %s\n", my_move);
 #endif
-                makemove(best_move, my_colour);
 
                 if (comms_send_move(my_move) == FAILURE)
                 {
                     running = 0;
-                    fprintf(fp, "Move send failed\n");
-                    fflush(fp);
+                    gamelog_message(&game_log, "Move send failed");
                     break;
                 }
-                printboard();   
+                record.h.seconds[my_colour - 1] += MPI_Wtime() - move_start;
+                record.h.nodes += nodes;
+                gamedb_move(&record, my_colour, temp_move > -1 ? BITSQUARE[temp_move] : -1);
+                TRACE_BEGIN(TRACE_IO, ply + 1);
+                gamelog_move(&game_log, ++ply, my_colour, temp_move, score, nodes,
+                             MPI_Wtime() - move_start, board);
+                TRACE_END(TRACE_IO, ply);
+                TRACE_END(TRACE_MOVE, ply);
             }
             else if (strcmp(cmd, "play_move") == 0)
             {
                 /* Add the opponent's move to my board */
                 play_move(opponent_move);
-                printboard();
+                /* waiting for the referee is the opponent's thinking time, near enough */
+                record.h.seconds[opponent(my_colour) - 1] += wait;
+                gamedb_move(&record, opponent(my_colour),
+                            strncmp(opponent_move, "pass", 4) == 0 ? -1 : BITSQUARE[get_loc(opponent_move)]);
+                TRACE_BEGIN(TRACE_IO, ply + 1);
+                gamelog_move(&game_log, ++ply, opponent(my_colour),
+                             strncmp(opponent_move, "pass", 4) == 0 ? -1 : get_loc(opponent_move),
+                             0, 0, 0.0, board);
+                TRACE_END(TRACE_IO, ply);
             }
         }
         /* send message to tell other processes to stop */
@@ -221,24 +410,32 @@ int main(int argc, char *argv[])
  */
 void initialise_board()
 {
-    int i;
     running = 1;
     board = (int *)malloc(BOARDSIZE * sizeof(int));
+    setup_board(board);
+}
+
+/*
+    Sets b to the starting position
+ */
+void setup_board(int *b)
+{
+    int i;
     for (i = 0; i <= 9; i++)
-        board[i] = OUTER;
+        b[i] = OUTER;
     for (i = 10; i <= 89; i++)
     {
         if (i % 10 >= 1 && i % 10 <= 8)
-            board[i] = EMPTY;
+            b[i] = EMPTY;
         else
-            board[i] = OUTER;
+            b[i] = OUTER;
     }
     for (i = 90; i <= 99; i++)
-        board[i] = OUTER;
-    board[44] = WHITE;
-    board[45] = BLACK;
-    board[54] = BLACK;
-    board[55] = WHITE;
+        b[i] = OUTER;
+    b[44] = WHITE;
+    b[45] = BLACK;
+    b[54] = BLACK;
+    b[55] = WHITE;
 }
 
 void free_board()
@@ -246,6 +443,74 @@ void free_board()
     free(board);
 }
 
+/**
+ * Function to search the board for my_colour with the worker ranks,
+ * rank 0 only. The board and colour go to every worker; in split mode
+ * each worker searches its share of the root moves, in lazy mode every
+ * worker searches all of them (see lazy.h), and in mcts mode every rank
+ * including this one grows a tree (see mcts.h). nodes is left holding
+ * the total over the workers.
+ *
+ * @param best_score  score of the chosen move
+ *
+ * @return chosen move, -1 to pass
+ */
+int parallel_search(int *best_score)
+{
+    int best_move = 0;
+    int temp_move = -1;
+    int temp_score = 0;
+    int score = ALPHA - 1;
+    long long worker_nodes;
+
+    nodes = 0;
+    TRACE_BEGIN(TRACE_SEARCH, search_depth);
+    journal_search(0);
+    /* send current board state and colour to processes */
+    for (int i = 1; i < size; i++)
+    {
+        TRACE_BEGIN(TRACE_SEND, i);
+        MPI_Send(board, BOARDSIZE, MPI_INT, i, COMPUTE, MPI_COMM_WORLD);
+        MPI_Send(&my_colour, 1, MPI_INT, i, COMPUTE, MPI_COMM_WORLD);
+        TRACE_END(TRACE_SEND, i);
+    }
+    if (search_mode != SEARCH_SPLIT)
+    {
+        temp_move = search_mode == SEARCH_LAZY ? lazy_master(best_score) : mcts_search(best_score);
+        journal_record(JOURNAL_CHOICE, temp_move > -1 ? BITSQUARE[temp_move] : -1, *best_score, 0, 0);
+        TRACE_END(TRACE_SEARCH, search_depth);
+        return temp_move;
+    }
+
+    /* get legal moves & calculate displacements and moves per process */
+    legalmoves(my_colour);
+    divide_moves(moves, local_moves);
+
+#ifdef DEBUG
+    print_process_moves(local_moves, send_counts);
+#endif
+    /* get the best move from each process and compare */
+    for (int i = 1; i < size; i++)
+    {
+        TRACE_BEGIN(TRACE_RECV, i);
+        MPI_Recv(&best_move, 1, MPI_INT, i, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        MPI_Recv(&temp_score, 1, MPI_INT, i, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        MPI_Recv(&worker_nodes, 1, MPI_LONG_LONG, i, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        TRACE_END(TRACE_RECV, i);
+        journal_arrival(i);
+        nodes += worker_nodes;
+        if (best_move > -1 && temp_score > score)
+        {
+            temp_move = best_move;
+            score = temp_score;
+        }
+    }
+    *best_score = score;
+    journal_record(JOURNAL_CHOICE, temp_move > -1 ? BITSQUARE[temp_move] : -1, score, 0, 0);
+    TRACE_END(TRACE_SEARCH, search_depth);
+    return temp_move;
+}
+
 /**
  * Function used for running worker functions during execution of program. 
  *  
@@ -259,51 +524,63 @@ void free_board()
  */
 void run_worker(int rank)
 {
-    int *temp_board, *legal_moves, my_score, current_move;
-    int temp_score = -1000;
+    int *legal_moves, my_score, current_move;
+    int temp_score = ALPHA - 1;
     int temp_move = -1;
-    int depth = 0;
     int best_move = 0; 
     
     MPI_Status status;
-    initialise_board();
+    setup_board(board);
+
+    /* the table lives as long as the worker, so it carries over between moves */
+    if (tt_table == NULL && tt_init(0) == FAILURE)
+    {
+        fprintf(stderr, "worker %d: cannot allocate the transposition table\n", rank);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
 
     char my_move[MOVEBUFSIZE];
     memset(my_move, 0, MOVEBUFSIZE);
     
-    int *process_counts, *process_displacements;
-    process_counts = (int *)malloc((size + 1) * sizeof(int));
-    process_displacements = (int *)malloc((size + 1) * sizeof(int));
-    
     if (my_colour == EMPTY)
     {
         my_colour = BLACK;
     }
     while (flag == 1)
     {
-        temp_score = -10000;
+        temp_score = ALPHA - 1;
+        temp_move = -1;
+        nodes = 0;
+        TRACE_BEGIN(TRACE_RECV, 0);
         MPI_Recv(board, BOARDSIZE, MPI_INT, 0, MPI_ANY_TAG, MPI_COMM_WORLD, &status);
-        legal_moves = legalmoves(my_colour);
-
-        /* determine how many moves each process gets */
-        for (int i = 1; i < size; i++)
+        TRACE_END(TRACE_RECV, 0);
+        if (status.MPI_TAG == STOP)
+            break;
+        MPI_Recv(&my_colour, 1, MPI_INT, 0, COMPUTE, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        journal_search(search_mode == SEARCH_LAZY ? rank - 1 : 0);
+        double busy_start = MPI_Wtime();
+        tt_new_search();
+        TRACE_BEGIN(TRACE_SEARCH, search_depth);
+        if (search_mode != SEARCH_SPLIT)
         {
-            process_counts[i] = moves[0] / (size - 1);
+            if (search_mode == SEARCH_LAZY)
+                lazy_worker();
+            else
+                mcts_search(&my_score);
+            TRACE_END(TRACE_SEARCH, search_depth);
+            continue;
         }
+        legal_moves = legalmoves(my_colour);
 
-        /* divide remainder between processes */
-        int remainder = moves[0] % (size - 1);
-        int curr_worker = 0;
-        while (remainder >= 0)
+        /* determine how many moves each process gets, the remainder going
+           one each to the first workers */
+        for (int i = 1; i < size; i++)
         {
-            process_counts[curr_worker]++;
-            curr_worker = (curr_worker + 1) % (size - 1);
-            remainder--;
+            process_counts[i] = moves[0] / (size - 1) + (i <= moves[0] % (size - 1));
         }
 
-        /* determine displacements */
-        int sum = 0;
-        process_displacements[1] = 0;
+        /* determine displacements, legal_moves[0] being the count */
+        int sum = 1;
         for (int i = 1; i < size; i++)
         {
             process_displacements[i] = sum;
@@ -321,22 +598,18 @@ void run_worker(int rank)
             printf("\n");
         }
 #endif
-        int i = process_displacements[rank];
-        if (rank == 1)
-            i = i + 1;
-        for (int j = i; j < process_displacements[rank] + process_counts[rank]; j++)
+        for (int j = process_displacements[rank]; j < process_displacements[rank] + process_counts[rank]; j++)
         {
             current_move = legal_moves[j];
-            temp_board = copy_board(board);
-            my_score = iterative_minimax(board, depth, MAX_DEPTH, my_colour, ALPHA, BETA);
+            TRACE_BEGIN(TRACE_ROOT_MOVE, BITSQUARE[current_move]);
+            my_score = search_move(current_move, my_colour, search_depth, ALPHA);
+            TRACE_END(TRACE_ROOT_MOVE, BITSQUARE[current_move]);
+            journal_record(JOURNAL_ROOT, BITSQUARE[current_move], my_score, 0, 0);
             if (my_score > temp_score)
             {
                 temp_score = my_score;
                 temp_move = current_move;
             }
-
-            board = copy_board(temp_board);
-            free(temp_board);
         }
         if (temp_move > -1)
         {
@@ -347,12 +620,18 @@ void run_worker(int rank)
             strncpy(my_move, "pass\n", MOVEBUFSIZE);
         }
         best_move = temp_move;
+        search_busy += MPI_Wtime() - busy_start;
+        journal_result(best_move, temp_score, 1, search_depth);
+        TRACE_END(TRACE_SEARCH, search_depth);
         if (status.MPI_TAG == COMPUTE)
         {
 
             /* process will send best move back to master */
+            TRACE_BEGIN(TRACE_SEND, 0);
             MPI_Send(&best_move, 1, MPI_INT, 0, 0, MPI_COMM_WORLD);
             MPI_Send(&temp_score, 1, MPI_INT, 0, 0, MPI_COMM_WORLD);
+            MPI_Send(&nodes, 1, MPI_LONG_LONG, 0, 0, MPI_COMM_WORLD);
+            TRACE_END(TRACE_SEND, 0);
         }
 
         else
@@ -364,7 +643,8 @@ void run_worker(int rank)
  * The function runs the algorithm with increasing 
  * depth until it reaches the maximum depth.
  * 
- * @param board 
+ * @param P 
+ * @param O 
  * @param current_depth 
  * @param max_depth 
  * @param player 
@@ -373,13 +653,15 @@ void run_worker(int rank)
  *
  * @return best_move
  *  */
-int iterative_minimax(int *board, int current_depth, int max_depth, int player, int alpha, int beta)
+int iterative_minimax(uint64_t P, uint64_t O, int current_depth, int max_depth, int player, int alpha, int beta)
 {
     int best_score = -ALPHA;
 
-    for (int depth = 0; depth < MAX_DEPTH; depth++)
+    for (int depth = current_depth + 1; depth <= max_depth; depth++)
     {
-        best_score = minimax(board, current_depth, depth, player, alpha, beta);
+        TRACE_BEGIN(TRACE_ITERATION, depth);
+        best_score = minimax(P, O, current_depth, depth, player, alpha, beta);
+        TRACE_END(TRACE_ITERATION, depth);
     }
     return best_score;
 }
@@ -447,122 +729,47 @@ void divide_moves(int *global_moves, int *process_moves)
         sum += send_counts[i];
     }
 }
-/**   
- *  Function to sort the list of legal moves
- *  prior to executing the minimax.
- *  
- *  @param  player
- *   
- */
-void sort_moves(int player)
-{
-    int *ratings = malloc(32 * sizeof(int));
-    int n;
-    moves = legalmoves(player);
-    int num_moves = moves[0];
-    for (int i = 1; i <= num_moves; i++)
-    {
-        n = moves[i];
-        ratings[i] = weights[n];
-    }
 
-    for (int i = 0; i < num_moves; ++i)
-    {
-        for (int j = i + 1; j < num_moves; ++j)
-        {
-            if (ratings[i] < ratings[j])
-            {
-                int temp = moves[i];
-                moves[i] = moves[j];
-                moves[j] = temp;
-            }
-        }
-    }
-}
-/**  
-    Function that copies the original board 
-    to a tempory board. 
-    Used to store previous board states. 
-    
-    @params: board to be copied    
+/**
+    Function to search a single root move. The move is played on
+    bitboards built from the global board and the reply is searched
+    with the iterative minimax; the global board is left untouched.
+    Scores are from my_colour's view, so player is expected to be
+    my_colour.
+
+    @param: move, player, max_depth, alpha
 
-    @return copied board
+    @return score of the move
  */
-int *copy_board(int *board)
+int search_move(int move, int player, int max_depth, int alpha)
 {
-    int *temp_board = (int *)malloc(BOARDSIZE * sizeof(int));
+    uint64_t P, O, flips;
+    int sq = BITSQUARE[move];
 
-    for (int i = 0; i < 99; i++)
-    {
-        temp_board[i] = board[i];
-    }
-
-    return temp_board;
+    bb_from_board(board, player, &P, &O);
+    flips = bb_flips(P, O, sq);
+    return iterative_minimax(O ^ flips, P ^ flips ^ (1ULL << sq), 1, max_depth,
+                             opponent(player), alpha, BETA);
 }
 
 /**
     Function to recursively perform MiniMax algorithm given a specific
     move and bored state.  
+    The position is passed as bitboards, P for the side to move and O
+    for its opponent, so children are built in registers and nothing
+    has to be undone. Scores are from my_colour's view; the search
+    itself is the negamax kernel with a copy per side to move, see
+    negamax.h.
     
-    @param: board, current_depth, max_depth, player, alpha, beta
+    @param: P, O, current_depth, max_depth, player, alpha, beta
 */
-int minimax(int *board, int current_depth, int max_depth, int player, int alpha, int beta)
-{ 
-    int *temp_board, *legal_moves;
-    int num_moves, score;
-    int prune = 0;
-
-    if (current_depth >= max_depth)
-    {
-        return evaluate_board(board, player);
-    }
-    legal_moves = legalmoves(my_colour);
-    num_moves = legal_moves[0];
-
-    if (num_moves == 0)
-    {
-        return evaluate_board(board, player);
-    }
-
-    for (int i = 1; i < num_moves; i++)
-    {
-
-        temp_board = copy_board(board);
-        makemove(legal_moves[i], player);
-        score = minimax(board, current_depth + 1, max_depth, opponent(player), alpha, beta);
-
-        if (player == my_colour) /* maximizing function */
-        { 
-            if (score > alpha)
-                alpha = score;
-        }
-
-        if (player == opponent(my_colour)) /* minimizing function */
-        { 
-            if (score < beta)
-                beta = score;
-        }
-
-        if (alpha > beta)
-            prune = 1;
-
-        board = copy_board(temp_board);
-        if (prune == 1)
-        {
-            /* share alphabeta */
-            if(current_depth < 2){
-                alpha_beta_sharing(alpha, beta);
-            }           
-
-            break;
-        }
-    }
-
+int minimax(uint64_t P, uint64_t O, int current_depth, int max_depth, int player, int alpha, int beta)
+{
     if (player == my_colour)
-        return alpha;
-    else
-        return beta;
+        return negamax_mine(P, O, current_depth, max_depth, alpha, beta);
+    return -negamax_theirs(P, O, current_depth, max_depth, -beta, -alpha);
 }
+
 /**
  * Function which allows one process to share alpha beta 
  * values with other processes. 
@@ -576,8 +783,11 @@ void alpha_beta_sharing(int alpha, int beta)
     char buffer[100];
     int available, a, b;
     int position = 0;
+    TRACE_BEGIN(TRACE_SHARE, rank);
     MPI_Pack(&alpha, 1, MPI_INT, buffer, 100, &position, MPI_COMM_WORLD);
     MPI_Pack(&beta, 1, MPI_INT, buffer, 100, &position, MPI_COMM_WORLD);
+    /* what goes out below is what was packed here */
+    journal_record(JOURNAL_SHARE_OUT, 0, alpha, beta, 0);
     for (int i = 0; i < size; i++)
     {
         if (i != rank)
@@ -591,6 +801,7 @@ void alpha_beta_sharing(int alpha, int beta)
                 MPI_Recv(buffer, 100, MPI_PACKED, i, SHARE, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
                 MPI_Unpack(buffer, 100, &position, &a, 1, MPI_INT, MPI_COMM_WORLD);
                 MPI_Unpack(buffer, 100, &position, &b, 1, MPI_INT, MPI_COMM_WORLD);
+                journal_record(JOURNAL_SHARE_IN, i, a, b, 0);
 
                 if (a > alpha)
                     alpha = a;
@@ -615,30 +826,7 @@ void alpha_beta_sharing(int alpha, int beta)
             MPI_Bsend(buffer, position, MPI_PACKED, i, SHARE, MPI_COMM_WORLD);
         }
     }
-}
-/**
- * Funciton to evaluate the state of the board
- * after a certan move was made
- * 
- * @param board
- * @param player
- * 
- * @return evaluation rating
- */
-int evaluate_board(int *board, int player)
-{
-    int player_moves, opp_moves, move;
-    player_moves = 0;
-    opp_moves = 0;
-    for (move = 11; move <= 88; move++)
-    {
-        if (legalp(move, player))
-            player_moves = weights[move] + player_moves;
-        if (legalp(move, opponent(player)))
-            opp_moves = weights[move] + opp_moves;
-    }
-
-    return player_moves - opp_moves;
+    TRACE_END(TRACE_SHARE, rank);
 }
 /*
     Called when the other engine has made a move. The move is given in a
@@ -662,7 +850,14 @@ void play_move(char *move)
 
 void game_over()
 {
+    trace_finish();
+    journal_finish();
+    gamelog_close(&game_log);
     free_board();
+    if (snapshot_path != NULL)
+        tt_snapshot_save(snapshot_path);
+    tt_free();
+    arena_free();
     MPI_Finalize();
 }
 
@@ -691,59 +886,55 @@ int *legalmoves(int player)
     int move, i;
     moves[0] = 0;
     i = 0;
-#ifdef DEBUG
-    if (rank == 0)
-        printf("all moves");
-#endif
-    for (move = 11; move <= 88; move++)
-        if (legalp(move, player))
+    for (int sq = 0; sq < 64; sq++)
+    {
+        move = PLAYABLE[sq];
+        if (board[move] == EMPTY && legalp(move, player))
         {
             i++;
             moves[i] = move;
-#ifdef DEBUG
-            printf(" %d", moves[i]);
-#endif
         }
+    }
     moves[0] = i;
-
-#ifdef DEBUG
-    printf("\n");
-#endif
     return moves;
 }
 
+/*
+    Only directions with room for a flip (LIVEDIRS) are tried, and
+    off-board locations have no live directions at all.
+ */
 int legalp(int move, int player)
 {
-    int i;
-    if (!validp(move))
+    int opp = OPPONENT[player];
+    int dir, c;
+
+    if (board[move] != EMPTY)
         return 0;
-    if (board[move] == EMPTY)
+    for (unsigned dirs = LIVEDIRS[move]; dirs; dirs &= dirs - 1)
     {
-        i = 0;
-        while (i <= 7 && !wouldflip(move, ALLDIRECTIONS[i], player))
-            i++;
-        if (i == 8)
-            return 0;
-        else
+        dir = ALLDIRECTIONS[__builtin_ctz(dirs)];
+        c = move + dir;
+        if (board[c] != opp)
+            continue;
+        do
+            c += dir;
+        while (board[c] == opp);
+        if (board[c] == player)
             return 1;
     }
-    else
-        return 0;
+    return 0;
 }
 
 int validp(int move)
 {
-    if ((move >= 11) && (move <= 88) && (move % 10 >= 1) && (move % 10 <= 8))
-        return 1;
-    else
-        return 0;
+    return move >= 0 && move < BOARDSIZE && VALIDSQUARE[move];
 }
 
 int wouldflip(int move, int dir, int player)
 {
     int c;
     c = move + dir;
-    if (board[c] == opponent(player))
+    if (board[c] == OPPONENT[player])
         return findbracketingpiece(c + dir, dir, player);
     else
         return 0;
@@ -751,7 +942,8 @@ int wouldflip(int move, int dir, int player)
 
 int findbracketingpiece(int square, int dir, int player)
 {
-    while (board[square] == opponent(player))
+    int opp = OPPONENT[player];
+    while (board[square] == opp)
         square = square + dir;
     if (board[square] == player)
         return square;
@@ -761,19 +953,12 @@ int findbracketingpiece(int square, int dir, int player)
 
 int opponent(int player)
 {
-    if (player == BLACK)
-        return WHITE;
-    if (player == WHITE)
-        return BLACK;
-    fprintf(fp, "illegal player\n");
-    return EMPTY;
+    return OPPONENT[player];
 }
 
 int randomstrategy(int player)
 {
     int r;
-    int *moves = (int *)malloc(LEGALMOVSBUFSIZE * sizeof(int));
-    memset(moves, 0, LEGALMOVSBUFSIZE);
     if (player == 1)
         my_colour = BLACK;
     else
@@ -787,16 +972,30 @@ int randomstrategy(int player)
     srand(time(NULL));
     /*choose random move from moves array */
     r = moves[(rand() % moves[0]) + 1];
-    //free(moves);
     return (r);
 }
 
 void makemove(int move, int player)
 {
-    int i;
+    int opp = OPPONENT[player];
+    int dir, c;
+
     board[move] = player;
-    for (i = 0; i <= 7; i++)
-        makeflips(move, ALLDIRECTIONS[i], player);
+    for (unsigned dirs = LIVEDIRS[move]; dirs; dirs &= dirs - 1)
+    {
+        dir = ALLDIRECTIONS[__builtin_ctz(dirs)];
+        c = move + dir;
+        if (board[c] != opp)
+            continue;
+        do
+            c += dir;
+        while (board[c] == opp);
+        if (board[c] == player)
+        {
+            for (c -= dir; c != move; c -= dir)
+                board[c] = player;
+        }
+    }
 }
 
 void makeflips(int move, int dir, int player)
@@ -814,19 +1013,15 @@ void makeflips(int move, int dir, int player)
     }
 }
 
+/*
+    Queues a full board dump on the game log, only written at the
+    verbose level.
+ */
 void printboard()
 {
-    int row, col;
-    fprintf(fp, "   1 2 3 4 5 6 7 8 [%c=%d %c=%d]\n",
-            nameof(BLACK), count(BLACK, board), nameof(WHITE), count(WHITE, board));
-    for (row = 1; row <= 8; row++)
-    {
-        fprintf(fp, "%d  ", row);
-        for (col = 1; col <= 8; col++)
-            fprintf(fp, "%c ", nameof(board[col + (10 * row)]));
-        fprintf(fp, "\n");
-    }
-    fflush(fp);
+    TRACE_BEGIN(TRACE_IO, 0);
+    gamelog_board(&game_log, board);
+    TRACE_END(TRACE_IO, 0);
 }
 
 char nameof(int piece)
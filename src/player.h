@@ -0,0 +1,70 @@
+#ifndef _PLAYER_H
+#define _PLAYER_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/* minimax algo */
+#define MAX_DEPTH 5
+#define ALPHA -30000 /* outside any evaluation, see EVAL_MAXSCORE */
+#define BETA 30000
+#define MAX_INT 30000
+
+/* how the worker ranks share a search */
+#define SEARCH_SPLIT 0 /* root moves divided between workers */
+#define SEARCH_LAZY 1  /* every worker searches the whole root, see lazy.h */
+#define SEARCH_MCTS 2  /* Monte Carlo tree search on every rank, see mcts.h */
+
+extern const int OUTER;
+extern const int ALLDIRECTIONS[8];
+extern const int BOARDSIZE;
+extern const int LEGALMOVSBUFSIZE;
+extern const int SHARE;
+extern const int COMPUTE, STOP; /* tags of the board messages to workers */
+
+int *gen_move(char *move);
+void play_move(char *move);
+void game_over();
+void run_worker();
+int parallel_search(int *best_score);
+void initialise_board();
+void setup_board(int *b);
+void free_board();
+
+int *legalmoves(int player);
+int legalp(int move, int player);
+int validp(int move);
+int wouldflip(int move, int dir, int player);
+int opponent(int player);
+int findbracketingpiece(int square, int dir, int player);
+int randomstrategy();
+void makemove(int move, int player);
+void makeflips(int move, int dir, int player);
+int get_loc(char *movestring);
+void get_move_string(int loc, char *ms);
+void printboard();
+char nameof(int piece);
+int count(int player, int *board);
+void divide_moves(int *global_moves, int *local_moves);
+int search_move(int move, int player, int max_depth, int alpha);
+int iterative_minimax(uint64_t P, uint64_t O, int current_depth, int max_depth, int player, int alpha, int beta);
+int minimax(uint64_t P, uint64_t O, int current_depth, int max_depth, int player, int alpha, int beta);
+void alpha_beta_sharing(int alpha, int beta);
+void print_process_moves(int *local_moves, int *send_counts); /* DEBUG */
+
+extern int my_colour;
+extern int time_limit;
+extern int running;
+extern int rank;
+extern int size;
+extern int *board;
+extern int *moves;
+extern int weights[100];
+extern int share_bounds;   /* alpha_beta_sharing() enabled */
+extern long long nodes;    /* minimax nodes visited */
+extern double search_busy; /* seconds this rank spent searching */
+extern int search_mode;    /* SEARCH_SPLIT, SEARCH_LAZY or SEARCH_MCTS */
+extern int search_depth;   /* depth the workers search to */
+extern int search_stopped; /* set to unwind a search that is no longer needed */
+
+#endif
@@ -0,0 +1,219 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <mpi.h>
+#include "comms.h"
+#include "player.h"
+#include "tables.h"
+#include "bitboard.h"
+#include "batch.h"
+#include "evaluate.h"
+#include "bench.h"
+#include "tt.h"
+#include "gamedb.h"
+#include "selfplay.h"
+
+static int search_timed(const struct batch_position *pos, double budget, struct batch_result *res);
+static int play_game(const struct batch_position *opening, int b_colour, const int *coef_a,
+                     const int *coef_b, double budget, double *depths, double *searches,
+                     struct gamedb_game *rec);
+static double elo(double score);
+
+/**
+ * Entry point for self-play, called on every rank. Rank 0 prints B's
+ * result against A.
+ *
+ * Usage: main --selfplay [--games n] [--time ms] [--eval-a m,s,f] [--eval-b m,s,f]
+ *
+ * A defaults to weighted mobility alone, B to the coefficients in use.
+ * With --record <db> every game is appended to the game database.
+ *
+ * @param argc
+ * @param argv
+ *
+ * @return SUCCESS or FAILURE
+ */
+int selfplay_main(int argc, char *argv[])
+{
+    int games = SELFPLAY_GAMES, time_ms = SELFPLAY_TIME;
+    int coef_a[EVAL_TERMS] = {1, 0, 0}, coef_b[EVAL_TERMS];
+    /* B wins, draws, losses; depth and searches for A then B */
+    double results[3] = {0, 0, 0}, depths[2] = {0, 0}, searches[2] = {0, 0};
+    double total_results[3], total_depths[2], total_searches[2];
+    struct batch_position *openings;
+    struct gamedb_game rec;
+
+    memcpy(coef_b, eval_coef, sizeof(coef_b));
+    for (int i = 2; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--games") == 0 && i + 1 < argc)
+            games = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--time") == 0 && i + 1 < argc)
+            time_ms = atoi(argv[++i]);
+        else if ((strcmp(argv[i], "--eval-a") == 0 || strcmp(argv[i], "--eval-b") == 0) && i + 1 < argc)
+        {
+            int *coef = argv[i][7] == 'a' ? coef_a : coef_b;
+            if (evaluate_parse_coef(argv[++i], coef) == FAILURE)
+            {
+                if (rank == 0)
+                    fprintf(stderr, "selfplay: coefficients are written m,s,f, not %s\n", argv[i]);
+                return FAILURE;
+            }
+        }
+    }
+    games += games % 2;
+
+    /* the table would hand one side's scores to the other */
+    if (tt_table != NULL)
+        tt_free();
+
+    openings = malloc(games / 2 * sizeof(struct batch_position));
+    bench_positions(openings, games / 2, SELFPLAY_SEED, 4, 10);
+    for (int g = rank; g < games; g += size)
+    {
+        int diff = play_game(&openings[g / 2], g % 2 ? WHITE : BLACK, coef_a, coef_b, time_ms / 1000.0,
+                             depths, searches, &rec);
+        results[diff > 0 ? 0 : diff == 0 ? 1 : 2]++;
+        rec.h.opening = g / 2;
+        rec.h.time_ms = time_ms;
+        if (gamedb_path != NULL)
+            gamedb_append(gamedb_path, &rec);
+    }
+    free(openings);
+    memcpy(eval_coef, coef_b, sizeof(coef_b));
+
+    MPI_Reduce(results, total_results, 3, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+    MPI_Reduce(depths, total_depths, 2, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+    MPI_Reduce(searches, total_searches, 2, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+    if (rank != 0)
+        return SUCCESS;
+
+    /* score and its standard error per game, then as an Elo difference */
+    double score = (total_results[0] + 0.5 * total_results[1]) / games;
+    double var = (total_results[0] * (1 - score) * (1 - score) + total_results[1] * (0.5 - score) * (0.5 - score) +
+                  total_results[2] * score * score) / games;
+    double margin = 1.96 * sqrt(var / games);
+    printf("selfplay: %d games, %d ms a move, A %d,%d,%d against B %d,%d,%d\n", games, time_ms,
+           coef_a[EVAL_MOBILITY], coef_a[EVAL_STABILITY], coef_a[EVAL_FRONTIER],
+           coef_b[EVAL_MOBILITY], coef_b[EVAL_STABILITY], coef_b[EVAL_FRONTIER]);
+    printf("B: %.0f wins %.0f draws %.0f losses, score %.1f%%, elo %+.0f (95%%: %+.0f to %+.0f)\n",
+           total_results[0], total_results[1], total_results[2], 100 * score, elo(score),
+           elo(score - margin), elo(score + margin));
+    printf("mean depth: A %.2f, B %.2f\n", total_searches[0] > 0 ? total_depths[0] / total_searches[0] : 0.0,
+           total_searches[1] > 0 ? total_depths[1] / total_searches[1] : 0.0);
+    return SUCCESS;
+}
+
+/**
+ * Function to play one game from an opening, A and B each searching
+ * with their own coefficients.
+ *
+ * @param opening
+ * @param b_colour  colour B plays
+ * @param coef_a
+ * @param coef_b
+ * @param budget    seconds a move
+ * @param depths    summed depth reached, A then B
+ * @param searches  number of searches, A then B
+ * @param rec       the game as played
+ *
+ * @return final disc difference from B's view
+ */
+static int play_game(const struct batch_position *opening, int b_colour, const int *coef_a,
+                     const int *coef_b, double budget, double *depths, double *searches,
+                     struct gamedb_game *rec)
+{
+    struct batch_position pos = *opening;
+    struct batch_result res;
+    int passes = 0;
+    /* depth and searches in this game, black then white */
+    double depth[2] = {0, 0}, count[2] = {0, 0};
+
+    gamedb_start(rec, pos.black, pos.white, pos.player, GAMEDB_SELFPLAY);
+    for (int i = 0; i < EVAL_TERMS; i++)
+    {
+        rec->h.coef[b_colour - 1][i] = coef_b[i];
+        rec->h.coef[2 - b_colour][i] = coef_a[i];
+    }
+
+    while (passes < 2)
+    {
+        uint64_t *P = pos.player == BLACK ? &pos.black : &pos.white;
+        uint64_t *O = pos.player == BLACK ? &pos.white : &pos.black;
+        int side = pos.player == b_colour;
+
+        if (bb_moves(*P, *O) == 0)
+        {
+            passes++;
+            pos.player = OPPONENT[pos.player];
+            continue;
+        }
+        passes = 0;
+        memcpy(eval_coef, side ? coef_b : coef_a, EVAL_TERMS * sizeof(int));
+        double t0 = MPI_Wtime();
+        int reached = search_timed(&pos, budget, &res);
+        rec->h.seconds[pos.player - 1] += MPI_Wtime() - t0;
+        rec->h.nodes += res.nodes;
+        depths[side] += reached;
+        searches[side]++;
+        depth[pos.player - 1] += reached;
+        count[pos.player - 1]++;
+
+        int sq = BITSQUARE[res.move];
+        gamedb_move(rec, pos.player, sq);
+        uint64_t flips = bb_flips(*P, *O, sq);
+        *P ^= flips | (1ULL << sq);
+        *O ^= flips;
+        pos.player = OPPONENT[pos.player];
+    }
+    for (int i = 0; i < 2; i++)
+        rec->h.depth[i] = count[i] > 0 ? depth[i] / count[i] + 0.5 : 0;
+    int diff = __builtin_popcountll(pos.black) - __builtin_popcountll(pos.white);
+    return b_colour == BLACK ? diff : -diff;
+}
+
+/**
+ * Function to search a position to increasing depths while the next
+ * depth is predicted to finish within the budget.
+ *
+ * @param pos
+ * @param budget  seconds
+ * @param res     result of the deepest search, nodes summed over all of them
+ *
+ * @return depth of that search
+ */
+static int search_timed(const struct batch_position *pos, double budget, struct batch_result *res)
+{
+    int empties = 64 - __builtin_popcountll(pos->black | pos->white);
+    int max_depth = empties < SELFPLAY_MAXDEPTH ? empties : SELFPLAY_MAXDEPTH;
+    double start = MPI_Wtime(), last, now;
+    long long total = 0;
+    int depth = 2;
+
+    /* a root move searched to depth 1 is not searched at all, start at 2 */
+    while (1)
+    {
+        double t0 = MPI_Wtime();
+        batch_analyse(pos, depth, res);
+        total += res->nodes;
+        now = MPI_Wtime();
+        last = now - t0;
+        if (depth >= max_depth || now - start + last * SELFPLAY_GROWTH > budget)
+        {
+            res->nodes = total;
+            return depth;
+        }
+        depth++;
+    }
+}
+
+/* Elo difference for an expected score, clamped at a clean sweep */
+static double elo(double score)
+{
+    if (score <= 0)
+        return -999;
+    if (score >= 1)
+        return 999;
+    return -400 * log10(1 / score - 1);
+}
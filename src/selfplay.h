@@ -0,0 +1,20 @@
+#ifndef _SELFPLAY_H
+#define _SELFPLAY_H
+
+/*
+    Self-play: two sets of evaluation coefficients, A and B, play each
+    other from seeded random openings, each opening twice with the
+    colours swapped. Both sides get the same time for every move and
+    deepen until the next ply is predicted not to fit, so an evaluation
+    that costs more pays for it in depth. Games are striped over the
+    ranks and the results are summed on rank 0.
+ */
+#define SELFPLAY_GAMES 100
+#define SELFPLAY_TIME 100 /* ms a move */
+#define SELFPLAY_GROWTH 4.0 /* time of the next ply over the last */
+#define SELFPLAY_MAXDEPTH 20
+#define SELFPLAY_SEED 20240607u
+
+int selfplay_main(int argc, char *argv[]);
+
+#endif
@@ -0,0 +1,350 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <poll.h>
+#include <mpi.h>
+#include "comms.h"
+#include "player.h"
+#include "gamelog.h"
+#include "transport.h"
+#include "server.h"
+#include "tables.h"
+#include "bitboard.h"
+#include "gamedb.h"
+
+struct server_game
+{
+    struct transport_conn conn; /* fd -1 when the slot is free */
+    int id;                     /* games started this session, for the log */
+    int colour;                 /* EMPTY between games */
+    int ply;
+    long queued;                /* order of its move request, 0 if none */
+    int *board;
+    double since;               /* our last reply, the start of the opponent's move */
+    struct gamedb_game record;  /* appended at game_over with --record */
+};
+
+static struct server_game games[SERVER_MAXGAMES];
+static long requests;
+static int started, finished;
+static struct gamelog session_log;
+static volatile sig_atomic_t stopping;
+
+static void handle_line(struct server_game *g, char *line);
+static int parse_move(struct server_game *g, const char *text, int *loc);
+static void reject(struct server_game *g, const char *line, const char *why);
+static void search(struct server_game *g);
+static void close_game(struct server_game *g);
+
+static void stop_handler(int sig)
+{
+    (void)sig;
+    stopping = 1;
+}
+
+/**
+ * Entry point for the server, called on every rank. Rank 0 listens and
+ * plays the games, the others are search workers for all of them. Runs
+ * until --games games have finished, or until SIGINT or SIGTERM.
+ *
+ * Usage: main --serve address [--games n] [--depth d] [--log file]
+ *
+ * @param argc
+ * @param argv
+ *
+ * @return SUCCESS or FAILURE
+ */
+int server_main(int argc, char *argv[])
+{
+    int max_games = 0, listener, over = 0;
+    int *home_board = board;
+    const char *log_path = NULL;
+    struct pollfd fds[SERVER_MAXGAMES + 1];
+    int slot_of[SERVER_MAXGAMES + 1];
+    struct sigaction sa;
+
+    for (int i = 3; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--games") == 0 && i + 1 < argc)
+            max_games = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--depth") == 0 && i + 1 < argc)
+            search_depth = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--log") == 0 && i + 1 < argc)
+            log_path = argv[++i];
+    }
+    if (rank != 0)
+    {
+        run_worker(rank);
+        return SUCCESS;
+    }
+
+    if (log_path != NULL && gamelog_open(&session_log, log_path) == FAILURE)
+        fprintf(stderr, "serve: cannot open %s\n", log_path);
+    listener = transport_listen(argv[2]);
+    if (listener != FAILURE)
+    {
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = stop_handler;
+        sigaction(SIGINT, &sa, NULL);
+        sigaction(SIGTERM, &sa, NULL);
+        for (int i = 0; i < SERVER_MAXGAMES; i++)
+        {
+            games[i].conn.fd = -1;
+            games[i].board = malloc(BOARDSIZE * sizeof(int));
+        }
+        printf("serve: listening on %s\n", argv[2]);
+        fflush(stdout);
+    }
+
+    while (listener != FAILURE && !stopping && (max_games == 0 || finished < max_games))
+    {
+        struct server_game *next = NULL;
+        int n = 0;
+        fds[n].fd = listener;
+        fds[n++].events = POLLIN;
+        for (int i = 0; i < SERVER_MAXGAMES; i++)
+        {
+            if (games[i].conn.fd < 0)
+                continue;
+            fds[n].fd = games[i].conn.fd;
+            fds[n].events = POLLIN;
+            slot_of[n++] = i;
+        }
+        /* with searches waiting only pick up what has already arrived */
+        for (int i = 0; i < SERVER_MAXGAMES; i++)
+        {
+            if (games[i].queued && (next == NULL || games[i].queued < next->queued))
+                next = &games[i];
+        }
+        if (poll(fds, n, next != NULL ? 0 : -1) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+
+        if (fds[0].revents & POLLIN)
+        {
+            int fd = transport_accept(listener), i;
+            for (i = 0; fd >= 0 && i < SERVER_MAXGAMES && games[i].conn.fd >= 0; i++)
+                ;
+            if (i == SERVER_MAXGAMES)
+                close(fd);
+            else if (fd >= 0)
+            {
+                games[i].conn.fd = fd;
+                games[i].conn.len = 0;
+                games[i].colour = EMPTY;
+                games[i].queued = 0;
+            }
+        }
+        for (int k = 1; k < n; k++)
+        {
+            struct server_game *g = &games[slot_of[k]];
+            char line[SERVER_LINESIZE];
+
+            if (!(fds[k].revents & (POLLIN | POLLHUP | POLLERR)))
+                continue;
+            if (transport_read(&g->conn) <= 0)
+            {
+                close_game(g);
+                continue;
+            }
+            while (g->conn.fd >= 0 && transport_line(&g->conn, line, sizeof(line)))
+                handle_line(g, line);
+        }
+
+        /* the oldest request, one a pass so commands are read between searches */
+        if (next != NULL && next->queued)
+        {
+            next->queued = 0;
+            search(next);
+        }
+    }
+
+    if (listener != FAILURE)
+    {
+        for (int i = 0; i < SERVER_MAXGAMES; i++)
+        {
+            if (games[i].conn.fd >= 0)
+                close_game(&games[i]);
+            free(games[i].board);
+        }
+        close(listener);
+        printf("serve: %d games started, %d finished\n", started, finished);
+    }
+    board = home_board;
+    gamelog_close(&session_log);
+    for (int i = 1; i < size; i++)
+        MPI_Send(&over, 1, MPI_INT, i, STOP, MPI_COMM_WORLD);
+    return listener == FAILURE ? FAILURE : SUCCESS;
+}
+
+/*
+    Runs one command from a game's referee. The game's board stands in
+    for the global one while its moves are made.
+ */
+static void handle_line(struct server_game *g, char *line)
+{
+    char text[GAMELOG_TEXTSIZE];
+    int *home_board = board;
+
+    if (strncmp(line, "new_game ", 9) == 0 && (line[9] == 'b' || line[9] == 'w'))
+    {
+        setup_board(g->board);
+        g->colour = line[9] == 'b' ? BLACK : WHITE;
+        g->id = ++started;
+        g->ply = 0;
+        g->queued = 0; /* a request left over from the last game is void */
+        if (gamedb_path != NULL)
+        {
+            uint64_t black, white;
+            bb_from_board(g->board, BLACK, &black, &white);
+            gamedb_start(&g->record, black, white, BLACK, GAMEDB_MATCH);
+            g->record.h.engine = g->colour;
+            g->record.h.depth[g->colour - 1] = search_depth;
+        }
+        g->since = MPI_Wtime();
+        snprintf(text, sizeof(text), "game %d: new, playing %s", g->id, g->colour == BLACK ? "black" : "white");
+        gamelog_message(&session_log, text);
+    }
+    else if (g->colour == EMPTY)
+    {
+        snprintf(text, sizeof(text), "serve: %.40s before new_game", line);
+        gamelog_message(&session_log, text);
+    }
+    else if (strncmp(line, "play_move ", 10) == 0)
+    {
+        int loc;
+        if (g->queued)
+            reject(g, line, "while our move is pending");
+        else if (parse_move(g, line + 10, &loc) == FAILURE)
+            reject(g, line, "is not a legal move");
+        else
+        {
+            board = g->board;
+            my_colour = g->colour;
+            if (loc > -1)
+                makemove(loc, opponent(my_colour));
+            board = home_board;
+            g->ply++;
+            if (gamedb_path != NULL)
+            {
+                g->record.h.seconds[opponent(g->colour) - 1] += MPI_Wtime() - g->since;
+                gamedb_move(&g->record, opponent(g->colour), loc > -1 ? BITSQUARE[loc] : -1);
+            }
+        }
+    }
+    else if (strcmp(line, "gen_move") == 0 && !g->queued)
+        g->queued = ++requests;
+    else if (strcmp(line, "game_over") == 0)
+    {
+        snprintf(text, sizeof(text), "game %d: over, black %d white %d", g->id, count(BLACK, g->board),
+                 count(WHITE, g->board));
+        gamelog_message(&session_log, text);
+        if (gamedb_path != NULL)
+            gamedb_append(gamedb_path, &g->record);
+        g->colour = EMPTY;
+        g->queued = 0;
+        finished++;
+    }
+    else
+    {
+        snprintf(text, sizeof(text), "serve: unknown command %.40s", line);
+        gamelog_message(&session_log, text);
+    }
+}
+
+/*
+    Checks a move from the referee before anything touches the board: it
+    has to be "pass" when the opponent has no move on the game's board,
+    or two digits 0-7 for a square it can play on. Sets loc to the board
+    location, -1 for a pass.
+ */
+static int parse_move(struct server_game *g, const char *text, int *loc)
+{
+    int *home_board = board, legal;
+
+    if (strcmp(text, "pass") == 0)
+    {
+        *loc = -1;
+        board = g->board;
+        legal = legalmoves(opponent(g->colour))[0] == 0;
+        board = home_board;
+        return legal ? SUCCESS : FAILURE;
+    }
+    if (text[0] < '0' || text[0] > '7' || text[1] < '0' || text[1] > '7' || text[2] != '\0')
+        return FAILURE;
+    *loc = get_loc((char *)text);
+    board = g->board;
+    legal = legalp(*loc, opponent(g->colour));
+    board = home_board;
+    return legal ? SUCCESS : FAILURE;
+}
+
+/*
+    Ends a game whose referee sent something that cannot be played,
+    leaving its board as it was.
+ */
+static void reject(struct server_game *g, const char *line, const char *why)
+{
+    char text[GAMELOG_TEXTSIZE];
+
+    snprintf(text, sizeof(text), "game %d: %.20s %s", g->id, line, why);
+    gamelog_message(&session_log, text);
+    transport_send(g->conn.fd, "error\n");
+    close_game(g);
+}
+
+/*
+    Searches a game's position with all the ranks and sends the reply.
+ */
+static void search(struct server_game *g)
+{
+    char my_move[MOVEBUFSIZE], text[GAMELOG_TEXTSIZE];
+    int *home_board = board;
+    int move, score;
+    double start = MPI_Wtime();
+
+    board = g->board;
+    my_colour = g->colour;
+    strncpy(my_move, "pass\n", MOVEBUFSIZE);
+    move = parallel_search(&score);
+    if (move > -1)
+    {
+        get_move_string(move, my_move);
+        makemove(move, my_colour);
+    }
+    board = home_board;
+    g->ply++;
+    if (gamedb_path != NULL)
+    {
+        g->record.h.seconds[g->colour - 1] += MPI_Wtime() - start;
+        g->record.h.nodes += nodes;
+        gamedb_move(&g->record, g->colour, move > -1 ? BITSQUARE[move] : -1);
+    }
+
+    snprintf(text, sizeof(text), "game %d: ply %d move %.2s score %d nodes %lld %.3fs", g->id, g->ply,
+             my_move, score, nodes, MPI_Wtime() - start);
+    gamelog_message(&session_log, text);
+    if (transport_send(g->conn.fd, my_move) == FAILURE)
+        close_game(g);
+    g->since = MPI_Wtime();
+}
+
+static void close_game(struct server_game *g)
+{
+    close(g->conn.fd);
+    g->conn.fd = -1;
+    g->queued = 0;
+    if (g->colour != EMPTY)
+    {
+        char text[GAMELOG_TEXTSIZE];
+        snprintf(text, sizeof(text), "game %d: referee left", g->id);
+        gamelog_message(&session_log, text);
+        g->colour = EMPTY;
+    }
+}
@@ -0,0 +1,26 @@
+#ifndef _SERVER_H
+#define _SERVER_H
+
+/*
+    Game server: one MPI job plays any number of games against referees
+    that connect over a socket transport (see transport.h), so process
+    and MPI startup are paid once a session rather than once a game.
+    Each connection is a game with its own board and colour, and the
+    referee drives it one command a line:
+        new_game b|w        start from the initial position as black or white
+        play_move rc|pass   the opponent's move, row and column digits
+        gen_move            answered with "rc" or "pass"
+        game_over           the game is finished, new_game may follow
+    Move requests from all games go into one queue and are searched in
+    turn with parallel_search(), so every search has all the ranks. A
+    play_move that is not a legal move for the opponent (a pass only when
+    it has none), or that comes while the game's gen_move is still
+    queued, is answered with "error" and the connection is closed, the
+    board untouched. new_game drops a gen_move still queued.
+ */
+#define SERVER_MAXGAMES 256
+#define SERVER_LINESIZE 64
+
+int server_main(int argc, char *argv[]);
+
+#endif
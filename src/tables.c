@@ -0,0 +1,41 @@
+#include "comms.h"
+#include "tables.h"
+
+#define SQ_ROW(sq) ((sq) / 10)
+#define SQ_COL(sq) ((sq) % 10)
+#define SQ_VALID(sq) (SQ_ROW(sq) >= 1 && SQ_ROW(sq) <= 8 && SQ_COL(sq) >= 1 && SQ_COL(sq) <= 8)
+
+/* steps from coordinate x to the edge going in direction d (-1, 0, 1) */
+#define STEPS(x, d) ((d) < 0 ? (x) - 1 : (d) > 0 ? 8 - (x) : 8)
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#define RAY(sq, dr, dc) (SQ_VALID(sq) ? MIN(STEPS(SQ_ROW(sq), dr), STEPS(SQ_COL(sq), dc)) : 0)
+
+/* in the order of ALLDIRECTIONS: -11, -10, -9, -1, 1, 9, 10, 11 */
+#define RAYS(sq) {RAY(sq, -1, -1), RAY(sq, -1, 0), RAY(sq, -1, 1), RAY(sq, 0, -1), \
+                  RAY(sq, 0, 1), RAY(sq, 1, -1), RAY(sq, 1, 0), RAY(sq, 1, 1)}
+#define LIVE(sq) ((RAY(sq, -1, -1) >= 2) << 0 | (RAY(sq, -1, 0) >= 2) << 1 | \
+                  (RAY(sq, -1, 1) >= 2) << 2 | (RAY(sq, 0, -1) >= 2) << 3 |  \
+                  (RAY(sq, 0, 1) >= 2) << 4 | (RAY(sq, 1, -1) >= 2) << 5 |   \
+                  (RAY(sq, 1, 0) >= 2) << 6 | (RAY(sq, 1, 1) >= 2) << 7)
+
+#define BIT(sq) (SQ_VALID(sq) ? (SQ_ROW(sq) - 1) * 8 + SQ_COL(sq) - 1 : -1)
+
+#define ROW10(m, r) m(10 * (r) + 0), m(10 * (r) + 1), m(10 * (r) + 2), m(10 * (r) + 3), \
+                    m(10 * (r) + 4), m(10 * (r) + 5), m(10 * (r) + 6), m(10 * (r) + 7), \
+                    m(10 * (r) + 8), m(10 * (r) + 9)
+#define BOARD100(m) ROW10(m, 0), ROW10(m, 1), ROW10(m, 2), ROW10(m, 3), ROW10(m, 4), \
+                    ROW10(m, 5), ROW10(m, 6), ROW10(m, 7), ROW10(m, 8), ROW10(m, 9)
+#define ROW8(r) 10 * (r) + 1, 10 * (r) + 2, 10 * (r) + 3, 10 * (r) + 4, \
+                10 * (r) + 5, 10 * (r) + 6, 10 * (r) + 7, 10 * (r) + 8
+
+const int OPPONENT[4] = {EMPTY, WHITE, BLACK, 3};
+
+const unsigned char VALIDSQUARE[100] = {BOARD100(SQ_VALID)};
+
+const int PLAYABLE[64] = {ROW8(1), ROW8(2), ROW8(3), ROW8(4), ROW8(5), ROW8(6), ROW8(7), ROW8(8)};
+
+const int BITSQUARE[100] = {BOARD100(BIT)};
+
+const unsigned char RAYLENGTH[100][8] = {BOARD100(RAYS)};
+
+const unsigned char LIVEDIRS[100] = {BOARD100(LIVE)};
@@ -0,0 +1,27 @@
+#ifndef _TABLES_H
+#define _TABLES_H
+
+/*
+    Lookup tables for the mailbox board (locations 0..99, playable
+    squares 11..88), all built by the preprocessor at compile time.
+ */
+
+/* opponent of each piece value, OUTER maps to itself */
+extern const int OPPONENT[4];
+
+/* 1 for the 64 playable locations */
+extern const unsigned char VALIDSQUARE[100];
+
+/* the 64 playable locations in board order */
+extern const int PLAYABLE[64];
+
+/* bit index (0..63) of each playable location, -1 elsewhere */
+extern const int BITSQUARE[100];
+
+/* squares between a location and the edge in each of ALLDIRECTIONS */
+extern const unsigned char RAYLENGTH[100][8];
+
+/* bit d is set if ALLDIRECTIONS[d] has room for a flip (ray of 2 or more) */
+extern const unsigned char LIVEDIRS[100];
+
+#endif
@@ -9,6 +9,7 @@
 #include <time.h>
 #include <assert.h>
 #include "test_opponent.h"
+#include "gamelog.h"
 
 const int O_EMPTY = 0;
 const int O_BLACK = 1;
@@ -43,15 +44,14 @@ int opponent_count(int player, int* board);
 
 int opponent_colour = O_WHITE;
 int *opponent_board;
-FILE *opponent_fp;
+int opponent_ply = 0;
+struct gamelog opponent_log;
 
 void opponent_initialise() {
     opponent_initialise_board();
     opponent_colour = O_WHITE;
 
-    opponent_fp = fopen("white.txt", "w");
-    fprintf(opponent_fp, "This is an example of output written to file.\n");
-    fflush(opponent_fp);
+    gamelog_open(&opponent_log, "white.txt");
 }
 
 /*
@@ -86,6 +86,7 @@ void opponent_gen_move(char *move){
         opponent_get_move_string(loc, move);
         opponent_makemove(loc, opponent_colour);
     }
+    gamelog_move(&opponent_log, ++opponent_ply, opponent_colour, loc, 0, 0, 0.0, opponent_board);
 }
 
 /*
@@ -103,9 +104,11 @@ void opponent_play_move(char *move){
     }
     loc = opponent_get_loc(move);
     opponent_makemove(loc, opponent_opponent(opponent_colour));
+    gamelog_move(&opponent_log, ++opponent_ply, opponent_opponent(opponent_colour), loc, 0, 0, 0.0, opponent_board);
 }
 
 void opponent_game_over(){
+    gamelog_close(&opponent_log);
     opponent_free_board();
 }
 
@@ -210,16 +213,7 @@ void opponent_makeflips (int move, int dir, int player) {
 }
 
 void opponent_printboard(){
-    int row, col;
-    fprintf(opponent_fp,"   1 2 3 4 5 6 7 8 [%c=%d %c=%d]\n",
-    opponent_nameof(O_BLACK), opponent_count(O_BLACK, opponent_board), opponent_nameof(O_WHITE), opponent_count(O_WHITE, opponent_board));
-    for (row=1; row<=8; row++) {
-        fprintf(opponent_fp,"%d  ", row);
-        for (col=1; col<=8; col++)
-            fprintf(opponent_fp,"%c ", opponent_nameof(opponent_board[col + (10 * row)]));
-        fprintf(opponent_fp,"\n");
-    }
-    fflush(opponent_fp);
+    gamelog_board(&opponent_log, opponent_board);
 }
 
 
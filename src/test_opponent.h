@@ -4,5 +4,6 @@
 void opponent_initialise();
 void opponent_apply_move(char move[]);
 void opponent_gen_move(char move[]);
+void opponent_game_over();
 
 #endif
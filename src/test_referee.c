@@ -7,6 +7,14 @@
 const int GAME_OVER = 3;
 static int status = BLACK;
 
+/* the opponent's log is flushed once, when the game ends */
+static void finish_game() {
+    if (status != GAME_OVER) {
+        status = GAME_OVER;
+        opponent_game_over();
+    }
+}
+
 int comms_init(int* my_colour) { 
     opponent_initialise();    
     *my_colour = BLACK;
@@ -20,7 +28,7 @@ int comms_get_cmd(char cmd[], char move[]) {
         opponent_gen_move(move);
         if (strncmp(move, "pass\n", MOVEBUFSIZE) == 0) {
             strncpy(cmd, "game_over", CMDBUFSIZE);
-            status = GAME_OVER;
+            finish_game();
         } else {
             strncpy(cmd, "play_move", CMDBUFSIZE);
             status = BLACK;
@@ -32,8 +40,8 @@ int comms_get_cmd(char cmd[], char move[]) {
 }
 
 int comms_send_move(char player_move[]) {
-    if (strncmp(player_move, "pass", MOVEBUFSIZE) == 0) { 
-        status = GAME_OVER;
+    if (strncmp(player_move, "pass", 4) == 0) { 
+        finish_game();
     } else {
         opponent_apply_move(player_move);    
         status = WHITE;
@@ -0,0 +1,338 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <mpi.h>
+#include "comms.h"
+#include "player.h"
+#include "topology.h"
+
+#define SYSCPU "/sys/devices/system/cpu"
+#define SYSNODE "/sys/devices/system/node"
+#define THP_SIZE ((size_t)2 << 20)
+#define PAGE_SIZE 4096
+
+int topology_pin = TOPO_NONE;
+
+static struct topology_cpu places[TOPO_MAXTHREADS]; /* this rank's, a thread each */
+static int my_threads;
+static size_t huge_size; /* reserved huge page size, 0 if none are reserved */
+static const char *page_kind;
+
+static int read_cpulist(const char *path, cpu_set_t *set);
+static struct topology_cpu describe(int cpu);
+static int by_compact(const void *a, const void *b);
+static int by_scatter(const void *a, const void *b);
+static void report(int node_rank, int cpus, int wrapped);
+static void pages_init();
+
+/**
+ * Function to look up a --pin mode.
+ *
+ * @param name  compact, scatter or none
+ *
+ * @return TOPO_COMPACT, TOPO_SCATTER, TOPO_NONE or FAILURE
+ */
+int topology_mode_from_name(const char *name)
+{
+    if (strcmp(name, "compact") == 0)
+        return TOPO_COMPACT;
+    if (strcmp(name, "scatter") == 0)
+        return TOPO_SCATTER;
+    if (strcmp(name, "none") == 0)
+        return TOPO_NONE;
+    return FAILURE;
+}
+
+/**
+ * Function to place this rank and its threads, and pin the calling
+ * thread as thread 0. Collective over MPI_COMM_WORLD when pinning,
+ * nothing to do otherwise.
+ *
+ * @param threads  search threads per rank
+ */
+void topology_init(int threads)
+{
+    MPI_Comm node_comm;
+    cpu_set_t mine, all;
+    struct topology_cpu *cpus;
+    int node_rank, node_size, n = 0;
+
+    if (topology_pin == TOPO_NONE)
+        return;
+    my_threads = threads < TOPO_MAXTHREADS ? threads : TOPO_MAXTHREADS;
+    MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &node_comm);
+    MPI_Comm_rank(node_comm, &node_rank);
+    MPI_Comm_size(node_comm, &node_size);
+
+    /* mpirun may have bound each rank already, the node's ranks together
+       may use what any of them may */
+    CPU_ZERO(&mine);
+    sched_getaffinity(0, sizeof(mine), &mine);
+    MPI_Allreduce(&mine, &all, sizeof(cpu_set_t), MPI_BYTE, MPI_BOR, node_comm);
+    MPI_Comm_free(&node_comm);
+
+    cpus = malloc(CPU_SETSIZE * sizeof(struct topology_cpu));
+    for (int c = 0; c < CPU_SETSIZE; c++)
+    {
+        if (CPU_ISSET(c, &all))
+            cpus[n++] = describe(c);
+    }
+    for (int m = 0; m < TOPO_MAXNUMA; m++)
+    {
+        char path[TOPO_LINESIZE];
+        cpu_set_t set;
+        snprintf(path, sizeof(path), SYSNODE "/node%d/cpulist", m);
+        if (read_cpulist(path, &set) == FAILURE)
+            continue;
+        for (int i = 0; i < n; i++)
+        {
+            if (CPU_ISSET(cpus[i].cpu, &set))
+                cpus[i].numa = m;
+        }
+    }
+
+    qsort(cpus, n, sizeof(struct topology_cpu), by_compact);
+    for (int i = 0; i < n; i++)
+    {
+        int same = i > 0 && cpus[i - 1].package == cpus[i].package && cpus[i - 1].smt == cpus[i].smt;
+        cpus[i].order = same ? cpus[i - 1].order + 1 : 0;
+    }
+    if (topology_pin == TOPO_SCATTER)
+        qsort(cpus, n, sizeof(struct topology_cpu), by_scatter);
+    for (int t = 0; t < my_threads; t++)
+        places[t] = cpus[(node_rank * my_threads + t) % n];
+    free(cpus);
+
+    topology_pin_thread(0);
+    report(node_rank, n, node_size * my_threads > n);
+}
+
+/**
+ * Function to pin the calling thread to its place, called by each
+ * search thread with its number. Does nothing without --pin.
+ *
+ * @param thread
+ */
+void topology_pin_thread(int thread)
+{
+    cpu_set_t set;
+
+    if (topology_pin == TOPO_NONE || my_threads == 0)
+        return;
+    CPU_ZERO(&set);
+    CPU_SET(places[thread % my_threads].cpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+/**
+ * Function to allocate a large table, zeroed. Pages are not touched
+ * here, so they are placed by whichever thread writes them first.
+ *
+ * @param bytes
+ *
+ * @return table, or NULL
+ */
+void *topology_alloc(size_t bytes)
+{
+    size_t unit, len;
+    void *p = MAP_FAILED;
+
+    pages_init();
+    /* the same length either way, so topology_free() need not know */
+    unit = huge_size > THP_SIZE ? huge_size : THP_SIZE;
+    len = (bytes + unit - 1) / unit * unit;
+    if (huge_size)
+        p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (p == MAP_FAILED)
+    {
+        p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED)
+            return NULL;
+        madvise(p, len, MADV_HUGEPAGE);
+    }
+    return p;
+}
+
+void topology_free(void *p, size_t bytes)
+{
+    size_t unit = huge_size > THP_SIZE ? huge_size : THP_SIZE;
+
+    if (p != NULL)
+        munmap(p, (bytes + unit - 1) / unit * unit);
+}
+
+/**
+ * Function to clear this rank's slice of memory shared by the ranks of
+ * comm, so the pages are spread over the NUMA nodes the ranks run on.
+ * Every rank of comm calls it; the caller synchronises afterwards.
+ *
+ * @param p
+ * @param bytes
+ * @param comm
+ */
+void topology_clear(void *p, size_t bytes, MPI_Comm comm)
+{
+    int me, ranks;
+    size_t slice, from, to;
+
+    MPI_Comm_rank(comm, &me);
+    MPI_Comm_size(comm, &ranks);
+    slice = (bytes / ranks + PAGE_SIZE - 1) / PAGE_SIZE * PAGE_SIZE;
+    from = me * slice < bytes ? me * slice : bytes;
+    to = from + slice < bytes ? from + slice : bytes;
+    if (me == ranks - 1)
+        to = bytes;
+    memset((char *)p + from, 0, to - from);
+}
+
+/*
+    Reads a list like "0-3,8-11" from a /sys file
+ */
+static int read_cpulist(const char *path, cpu_set_t *set)
+{
+    FILE *f = fopen(path, "r");
+    int lo, hi, c;
+
+    if (f == NULL)
+        return FAILURE;
+    CPU_ZERO(set);
+    while (fscanf(f, "%d", &lo) == 1)
+    {
+        hi = lo;
+        c = fgetc(f);
+        if (c == '-' && fscanf(f, "%d", &hi) == 1)
+            c = fgetc(f);
+        for (int i = lo; i <= hi && i < CPU_SETSIZE; i++)
+            CPU_SET(i, set);
+        if (c != ',')
+            break;
+    }
+    fclose(f);
+    return SUCCESS;
+}
+
+static int read_int(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    int value = -1;
+
+    if (f != NULL)
+    {
+        if (fscanf(f, "%d", &value) != 1)
+            value = -1;
+        fclose(f);
+    }
+    return value;
+}
+
+static struct topology_cpu describe(int cpu)
+{
+    struct topology_cpu d = {cpu, 0, cpu, 0, 0, 0};
+    char path[TOPO_LINESIZE];
+    cpu_set_t siblings;
+
+    snprintf(path, sizeof(path), SYSCPU "/cpu%d/topology/physical_package_id", cpu);
+    if ((d.package = read_int(path)) < 0)
+        d.package = 0;
+    snprintf(path, sizeof(path), SYSCPU "/cpu%d/topology/core_id", cpu);
+    if ((d.core = read_int(path)) < 0)
+        d.core = cpu;
+    snprintf(path, sizeof(path), SYSCPU "/cpu%d/topology/thread_siblings_list", cpu);
+    if (read_cpulist(path, &siblings) == SUCCESS)
+    {
+        for (int i = 0; i < cpu; i++)
+            d.smt += CPU_ISSET(i, &siblings) != 0;
+    }
+    return d;
+}
+
+static int by_compact(const void *a, const void *b)
+{
+    const struct topology_cpu *x = a, *y = b;
+
+    if (x->smt != y->smt)
+        return x->smt - y->smt;
+    if (x->package != y->package)
+        return x->package - y->package;
+    if (x->core != y->core)
+        return x->core - y->core;
+    return x->cpu - y->cpu;
+}
+
+static int by_scatter(const void *a, const void *b)
+{
+    const struct topology_cpu *x = a, *y = b;
+
+    if (x->smt != y->smt)
+        return x->smt - y->smt;
+    if (x->order != y->order)
+        return x->order - y->order;
+    return x->package - y->package;
+}
+
+/*
+    Collects a line from every rank on rank 0 and prints them
+ */
+static void report(int node_rank, int cpus, int wrapped)
+{
+    char line[TOPO_LINESIZE], host[MPI_MAX_PROCESSOR_NAME], *all = NULL;
+    int len, used;
+
+    pages_init();
+    MPI_Get_processor_name(host, &len);
+    used = snprintf(line, sizeof(line), "pin: rank %d on %s node rank %d: cpu %d package %d core %d numa %d",
+                    rank, host, node_rank, places[0].cpu, places[0].package, places[0].core, places[0].numa);
+    for (int t = 1; t < my_threads && used < TOPO_LINESIZE; t++)
+        used += snprintf(line + used, sizeof(line) - used, "%s%d", t == 1 ? ", threads on cpus " : " ",
+                         places[t].cpu);
+    if (rank == 0)
+        all = malloc((size_t)size * TOPO_LINESIZE);
+    MPI_Gather(line, TOPO_LINESIZE, MPI_CHAR, all, TOPO_LINESIZE, MPI_CHAR, 0, MPI_COMM_WORLD);
+    if (rank != 0)
+        return;
+    fprintf(stderr, "pin: %s over %d cpus%s, tables in %s pages\n",
+            topology_pin == TOPO_COMPACT ? "compact" : "scatter", cpus,
+            wrapped ? " (more threads than cpus, some share)" : "", page_kind);
+    for (int i = 0; i < size; i++)
+        fprintf(stderr, "%s\n", all + (size_t)i * TOPO_LINESIZE);
+    free(all);
+}
+
+/*
+    Finds out once whether huge pages are reserved or transparent ones
+    can be asked for
+ */
+static void pages_init()
+{
+    FILE *f;
+    char text[TOPO_LINESIZE];
+    long total = 0, kb = 0;
+
+    if (page_kind != NULL)
+        return;
+    page_kind = "normal";
+    if ((f = fopen("/proc/meminfo", "r")) != NULL)
+    {
+        while (fgets(text, sizeof(text), f) != NULL)
+        {
+            sscanf(text, "HugePages_Total: %ld", &total);
+            sscanf(text, "Hugepagesize: %ld", &kb);
+        }
+        fclose(f);
+    }
+    if (total > 0 && kb > 0)
+    {
+        huge_size = (size_t)kb << 10;
+        page_kind = "reserved huge";
+    }
+    else if ((f = fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r")) != NULL)
+    {
+        if (fgets(text, sizeof(text), f) != NULL && strstr(text, "[never]") == NULL)
+            page_kind = "transparent huge";
+        fclose(f);
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef _TOPOLOGY_H
+#define _TOPOLOGY_H
+
+#include <stddef.h>
+#include <mpi.h>
+
+/*
+    Node topology and pinning (--pin compact|scatter). The ranks on a
+    node are found with MPI_Comm_split_type(MPI_COMM_TYPE_SHARED), and
+    the CPUs they may use (the union of their affinity masks, so start
+    mpirun with --bind-to none to hand them the whole node) are read
+    from /sys with their package, core and NUMA node. The CPUs are put
+    in order, second hardware threads of a core after every first one
+    so each rank and search thread has a core to itself while there
+    are enough:
+        compact   one package filled before the next
+        scatter   round robin over the packages, for memory bandwidth
+    With T threads per rank (--threads under --search mcts, else 1)
+    node rank r takes places r*T ... r*T+T-1 of the order, wrapping if
+    the node has too few CPUs; thread 0 is the rank's own thread.
+
+    Large tables come from topology_alloc(): anonymous memory in huge
+    pages when some are reserved, else marked for transparent huge
+    pages, and left untouched so each page lands on the NUMA node of
+    the pinned thread that first writes it. The node-shared table is
+    cleared a slice per node rank, which spreads it over the NUMA nodes
+    of the ranks sharing it. With --pin rank 0 prints where every rank
+    and thread runs.
+ */
+#define TOPO_NONE 0
+#define TOPO_COMPACT 1
+#define TOPO_SCATTER 2
+#define TOPO_MAXTHREADS 64
+#define TOPO_MAXNUMA 64
+#define TOPO_LINESIZE 256
+
+struct topology_cpu
+{
+    int cpu;
+    int package;
+    int core;
+    int smt; /* hardware thread within its core, 0 first */
+    int numa;
+    int order; /* place within its package and smt level */
+};
+
+extern int topology_pin; /* TOPO_NONE, TOPO_COMPACT or TOPO_SCATTER */
+
+int topology_mode_from_name(const char *name);
+void topology_init(int threads);
+void topology_pin_thread(int thread);
+void *topology_alloc(size_t bytes);
+void topology_free(void *p, size_t bytes);
+void topology_clear(void *p, size_t bytes, MPI_Comm comm);
+
+#endif
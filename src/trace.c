@@ -0,0 +1,148 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <mpi.h>
+#include "comms.h"
+#include "player.h"
+#include "trace.h"
+
+int trace_on = 0;
+
+static const char *trace_path;
+static struct trace_event *ring;
+static long recorded;
+static double origin;
+
+/* name and argument label of each event */
+static const char *trace_names[][2] = {
+    {"move", "ply"},     {"search", "depth"}, {"iteration", "depth"},     {"root move", "square"}, {"send", "to"},
+    {"recv", "from"},    {"share bounds", "rank"}, {"log io", "ply"}, {"referee", "ply"},
+};
+
+static void write_json(FILE *out, struct trace_event *events, int *counts);
+
+/**
+ * Function to start tracing, called on every rank with the same path.
+ * Nothing happens with a NULL path.
+ *
+ * @param path  where trace_finish() writes the trace
+ */
+void trace_init(const char *path)
+{
+    if (path == NULL)
+        return;
+    ring = malloc(TRACE_EVENTS * sizeof(struct trace_event));
+    if (ring == NULL)
+    {
+        fprintf(stderr, "trace: cannot allocate the event ring\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    trace_path = path;
+    MPI_Barrier(MPI_COMM_WORLD);
+    origin = MPI_Wtime();
+    trace_on = 1;
+}
+
+/*
+    Called through TRACE_BEGIN() and TRACE_END() only
+ */
+void trace_record(int name, int arg, char phase)
+{
+    struct trace_event *e = &ring[recorded++ & (TRACE_EVENTS - 1)];
+
+    e->time = MPI_Wtime() - origin;
+    e->name = name;
+    e->arg = arg;
+    e->phase = phase;
+}
+
+/**
+ * Function to gather every rank's events on rank 0 and write the trace.
+ * Collective; does nothing unless tracing was started.
+ */
+void trace_finish()
+{
+    int count, bytes, *counts = NULL, *displs = NULL;
+    struct trace_event *mine, *all = NULL;
+    long first;
+
+    if (trace_path == NULL)
+        return;
+    trace_on = 0;
+    count = recorded < TRACE_EVENTS ? recorded : TRACE_EVENTS;
+    first = recorded - count;
+
+    /* oldest first, the ring may have wrapped */
+    mine = malloc((count + 1) * sizeof(struct trace_event));
+    for (int i = 0; i < count; i++)
+        mine[i] = ring[(first + i) & (TRACE_EVENTS - 1)];
+    bytes = count * sizeof(struct trace_event);
+
+    if (rank == 0)
+    {
+        counts = malloc(size * sizeof(int));
+        displs = malloc(size * sizeof(int));
+    }
+    MPI_Gather(&bytes, 1, MPI_INT, counts, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    if (rank == 0)
+    {
+        int total = 0;
+        for (int i = 0; i < size; i++)
+        {
+            displs[i] = total;
+            total += counts[i];
+        }
+        all = malloc(total + 1);
+    }
+    MPI_Gatherv(mine, bytes, MPI_BYTE, all, counts, displs, MPI_BYTE, 0, MPI_COMM_WORLD);
+
+    if (rank == 0)
+    {
+        FILE *out = fopen(trace_path, "w");
+        long events = 0;
+        for (int i = 0; i < size; i++)
+            events += counts[i] / sizeof(struct trace_event);
+        if (out == NULL)
+            fprintf(stderr, "trace: cannot open %s\n", trace_path);
+        else
+        {
+            write_json(out, all, counts);
+            fclose(out);
+            printf("trace: %ld events from %d ranks written to %s\n", events, size, trace_path);
+        }
+        free(counts);
+        free(displs);
+        free(all);
+    }
+    if (recorded > TRACE_EVENTS)
+        fprintf(stderr, "trace: rank %d dropped its %ld oldest events\n", rank, recorded - TRACE_EVENTS);
+    free(mine);
+    free(ring);
+    ring = NULL;
+    trace_path = NULL;
+}
+
+/*
+    Chrome trace event format: a process per rank, times in microseconds
+ */
+static void write_json(FILE *out, struct trace_event *events, int *counts)
+{
+    const char *sep = "";
+
+    fprintf(out, "{\"traceEvents\":[\n");
+    for (int r = 0; r < size; r++)
+    {
+        int n = counts[r] / sizeof(struct trace_event);
+        fprintf(out, "%s{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":0,\"args\":{\"name\":\"rank %d\"}}",
+                sep, r, r);
+        sep = ",\n";
+        for (int i = 0; i < n; i++, events++)
+        {
+            fprintf(out, ",\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":%d,\"tid\":0", trace_names[events->name][0],
+                    events->phase, events->time * 1e6, r);
+            if (events->phase == 'B')
+                fprintf(out, ",\"args\":{\"%s\":%d}", trace_names[events->name][1], events->arg);
+            fputc('}', out);
+        }
+    }
+    fprintf(out, "\n],\"displayTimeUnit\":\"ms\"}\n");
+}
@@ -0,0 +1,63 @@
+#ifndef _TRACE_H
+#define _TRACE_H
+
+/*
+    Timeline tracing (--trace file). Each rank records begin and end
+    events (moves, searches, iterations, root moves, MPI waits, bound
+    sharing and log I/O) into a ring of TRACE_EVENTS entries; when the
+    ring is full the oldest events are overwritten, so a long game keeps
+    its end. At game_over() the rings are gathered on rank 0 and written
+    as one Chrome trace (JSON), a process per rank, for chrome://tracing
+    or ui.perfetto.dev. Timestamps count from a barrier at startup.
+
+    Only the rank's own thread records. Recording is a test of
+    trace_on and a store; build with -DNO_TRACE (make
+    GCC_SUPPFLAGS=-DNO_TRACE after a make clean) and the macros compile
+    to nothing.
+ */
+#define TRACE_EVENTS (1 << 16)
+
+/* event names, see trace_names in trace.c */
+#define TRACE_MOVE 0
+#define TRACE_SEARCH 1
+#define TRACE_ITERATION 2
+#define TRACE_ROOT_MOVE 3
+#define TRACE_SEND 4
+#define TRACE_RECV 5
+#define TRACE_SHARE 6
+#define TRACE_IO 7
+#define TRACE_REFEREE 8
+
+struct trace_event
+{
+    double time;
+    int name;
+    int arg;
+    char phase; /* 'B' begin, 'E' end */
+};
+
+extern int trace_on;
+
+#ifndef NO_TRACE
+#define TRACE_BEGIN(name, arg)                \
+    do                                        \
+    {                                         \
+        if (trace_on)                         \
+            trace_record(name, arg, 'B');     \
+    } while (0)
+#define TRACE_END(name, arg)                  \
+    do                                        \
+    {                                         \
+        if (trace_on)                         \
+            trace_record(name, arg, 'E');     \
+    } while (0)
+#else
+#define TRACE_BEGIN(name, arg) ((void)0)
+#define TRACE_END(name, arg) ((void)0)
+#endif
+
+void trace_init(const char *path);
+void trace_record(int name, int arg, char phase);
+void trace_finish();
+
+#endif
@@ -0,0 +1,243 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include "comms.h"
+#include "transport.h"
+
+static int tcp_open(const char *where, int listening);
+static int unix_open(const char *where, int listening);
+
+static const struct
+{
+    const char *prefix;
+    int (*open)(const char *where, int listening);
+} transports[] = {
+    {"tcp:", tcp_open},
+    {"unix:", unix_open},
+};
+
+static int transport_open(const char *address, int listening)
+{
+    for (size_t i = 0; i < sizeof(transports) / sizeof(transports[0]); i++)
+    {
+        size_t n = strlen(transports[i].prefix);
+        if (strncmp(address, transports[i].prefix, n) == 0)
+            return transports[i].open(address + n, listening);
+    }
+    fprintf(stderr, "transport: %s is not tcp:host:port or unix:path\n", address);
+    return FAILURE;
+}
+
+/**
+ * Function to open a socket for referees to connect to.
+ *
+ * @param address
+ *
+ * @return listening descriptor, or FAILURE
+ */
+int transport_listen(const char *address)
+{
+    return transport_open(address, 1);
+}
+
+/**
+ * Function to connect to a listening socket.
+ *
+ * @param address
+ *
+ * @return connected descriptor, or FAILURE
+ */
+int transport_connect(const char *address)
+{
+    return transport_open(address, 0);
+}
+
+/**
+ * Function to take the next connection from a listening socket.
+ *
+ * @param listener
+ *
+ * @return connected descriptor, or FAILURE
+ */
+int transport_accept(int listener)
+{
+    int fd = accept(listener, NULL, NULL);
+    int one = 1;
+
+    if (fd < 0)
+        return FAILURE;
+    /* moves are single short lines, send them as soon as they are written */
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+static int tcp_open(const char *where, int listening)
+{
+    char host[TRANSPORT_BUFSIZE];
+    const char *port = strrchr(where, ':');
+    struct addrinfo hints, *found, *ai;
+    int fd = FAILURE, one = 1;
+
+    if (port == NULL || (size_t)(port - where) >= sizeof(host))
+    {
+        fprintf(stderr, "transport: tcp address %s is not host:port\n", where);
+        return FAILURE;
+    }
+    memcpy(host, where, port - where);
+    host[port - where] = 0;
+    port++;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = listening ? AI_PASSIVE : 0;
+    if (getaddrinfo(host[0] ? host : NULL, port, &hints, &found) != 0)
+    {
+        fprintf(stderr, "transport: cannot resolve %s\n", where);
+        return FAILURE;
+    }
+    for (ai = found; ai != NULL; ai = ai->ai_next)
+    {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0)
+            continue;
+        if (listening)
+        {
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+            if (bind(fd, ai->ai_addr, ai->ai_addrlen) == 0 && listen(fd, TRANSPORT_BACKLOG) == 0)
+                break;
+        }
+        else if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0)
+        {
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            break;
+        }
+        close(fd);
+        fd = FAILURE;
+    }
+    freeaddrinfo(found);
+    if (fd == FAILURE)
+        fprintf(stderr, "transport: cannot %s tcp:%s: %s\n", listening ? "listen on" : "connect to", where,
+                strerror(errno));
+    return fd;
+}
+
+static int unix_open(const char *where, int listening)
+{
+    struct sockaddr_un addr;
+    int fd;
+
+    if (strlen(where) >= sizeof(addr.sun_path))
+    {
+        fprintf(stderr, "transport: socket path %s is too long\n", where);
+        return FAILURE;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, where);
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return FAILURE;
+    if (listening)
+    {
+        /* a socket file left by an earlier server would make bind fail */
+        unlink(where);
+        if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0 && listen(fd, TRANSPORT_BACKLOG) == 0)
+            return fd;
+    }
+    else if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0)
+        return fd;
+
+    fprintf(stderr, "transport: cannot %s unix:%s: %s\n", listening ? "listen on" : "connect to", where,
+            strerror(errno));
+    close(fd);
+    return FAILURE;
+}
+
+/**
+ * Function to read whatever has arrived on a connection into its buffer.
+ * Call it when poll() reports the descriptor readable, so it does not
+ * block.
+ *
+ * @param conn
+ *
+ * @return bytes read, 0 once the other end has closed, or FAILURE on an
+ *         error or a line too long for the buffer
+ */
+int transport_read(struct transport_conn *conn)
+{
+    ssize_t got;
+
+    if (conn->len >= TRANSPORT_BUFSIZE)
+        return FAILURE;
+    do
+        got = read(conn->fd, conn->buf + conn->len, TRANSPORT_BUFSIZE - conn->len);
+    while (got < 0 && errno == EINTR);
+    if (got < 0)
+        return FAILURE;
+    conn->len += got;
+    return got;
+}
+
+/**
+ * Function to take the next complete line from a connection's buffer.
+ *
+ * @param conn
+ * @param line  filled with the line, without its newline
+ * @param size
+ *
+ * @return 1 if there was a line, 0 if not yet
+ */
+int transport_line(struct transport_conn *conn, char *line, int size)
+{
+    char *end = memchr(conn->buf, '\n', conn->len);
+    int n;
+
+    if (end == NULL)
+        return 0;
+    n = end - conn->buf;
+    if (n > 0 && conn->buf[n - 1] == '\r')
+        n--;
+    if (n >= size)
+        n = size - 1;
+    memcpy(line, conn->buf, n);
+    line[n] = 0;
+    conn->len -= end + 1 - conn->buf;
+    memmove(conn->buf, end + 1, conn->len);
+    return 1;
+}
+
+/**
+ * Function to write a whole message.
+ *
+ * @param fd
+ * @param text
+ *
+ * @return SUCCESS or FAILURE
+ */
+int transport_send(int fd, const char *text)
+{
+    size_t left = strlen(text);
+    ssize_t sent;
+
+    while (left > 0)
+    {
+        /* a referee that has gone away must not take the server with it */
+        sent = send(fd, text, left, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR)
+            continue;
+        if (sent <= 0)
+            return FAILURE;
+        text += sent;
+        left -= sent;
+    }
+    return SUCCESS;
+}
@@ -0,0 +1,32 @@
+#ifndef _TRANSPORT_H
+#define _TRANSPORT_H
+
+/*
+    Socket transport for talking to a referee. An address names the
+    transport and where to find it:
+        tcp:host:port    TCP, an empty host listening on every interface
+        unix:path        Unix domain stream socket
+    Each transport is an entry in a table with the prefix it answers to,
+    so another kind of socket is one more open function.
+
+    Messages are lines of text. A connection keeps what has been read
+    but not yet taken as a line, so the reader can poll many at once.
+ */
+#define TRANSPORT_BUFSIZE 256
+#define TRANSPORT_BACKLOG 64
+
+struct transport_conn
+{
+    int fd;
+    int len;
+    char buf[TRANSPORT_BUFSIZE];
+};
+
+int transport_listen(const char *address);
+int transport_connect(const char *address);
+int transport_accept(int listener);
+int transport_read(struct transport_conn *conn);
+int transport_line(struct transport_conn *conn, char *line, int size);
+int transport_send(int fd, const char *text);
+
+#endif
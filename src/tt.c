@@ -0,0 +1,339 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <mpi.h>
+#include "comms.h"
+#include "player.h"
+#include "evaluate.h"
+#include "mpc.h"
+#include "tt.h"
+#include "topology.h"
+
+/* data word: score + 32768 | depth << 16 | bound << 24 | move << 26 | age << 33 */
+#define TT_SCORE(d) ((int)((d) & 0xffff) - 32768)
+#define TT_DEPTH(d) ((int)(((d) >> 16) & 0xff))
+#define TT_BOUND(d) ((int)(((d) >> 24) & 3))
+#define TT_MOVE(d) ((int)(((d) >> 26) & 0x7f))
+#define TT_AGE(d) ((unsigned)(((d) >> 33) & 0xff))
+
+struct tt_entry *tt_table = NULL;
+uint64_t tt_mask;
+static MPI_Win tt_win = MPI_WIN_NULL;
+static MPI_Comm tt_comm = MPI_COMM_NULL;
+unsigned tt_generation = 0;
+int tt_cutoffs = 1;
+
+static const struct tt_entry *snapshot = NULL;
+static size_t snapshot_bytes;
+
+static void merge_entries(void *in, void *inout, int *len, MPI_Datatype *type);
+
+/**
+ * Function to allocate the table. A shared table lives in a window that
+ * node rank 0 allocates and every rank on the node maps and clears a
+ * slice of; this is collective over MPI_COMM_WORLD. A private table
+ * comes from topology_alloc(), see topology.h.
+ *
+ * @param shared
+ *
+ * @return SUCCESS or FAILURE
+ */
+int tt_init(int shared)
+{
+    MPI_Aint bytes = ((MPI_Aint)1 << TT_BITS) * sizeof(struct tt_entry);
+
+    tt_mask = ((uint64_t)1 << TT_BITS) - 1;
+    if (!shared)
+    {
+        tt_table = topology_alloc(bytes);
+        return tt_table == NULL ? FAILURE : SUCCESS;
+    }
+
+    int node_rank, disp;
+    MPI_Aint got;
+    MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &tt_comm);
+    MPI_Comm_rank(tt_comm, &node_rank);
+    if (MPI_Win_allocate_shared(node_rank == 0 ? bytes : 0, sizeof(struct tt_entry), MPI_INFO_NULL,
+                                tt_comm, &tt_table, &tt_win) != MPI_SUCCESS)
+        return FAILURE;
+    MPI_Win_shared_query(tt_win, 0, &got, &disp, &tt_table);
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, tt_win);
+    topology_clear(tt_table, bytes, tt_comm);
+    MPI_Win_sync(tt_win);
+    MPI_Barrier(tt_comm);
+    return SUCCESS;
+}
+
+/**
+ * Function to empty the table. With a shared table only node rank 0
+ * should call this, while no rank is searching.
+ */
+void tt_clear()
+{
+    if (tt_table != NULL)
+        memset(tt_table, 0, ((size_t)1 << TT_BITS) * sizeof(struct tt_entry));
+}
+
+/*
+    Collective for a shared table, like tt_init().
+ */
+void tt_free()
+{
+    if (tt_win != MPI_WIN_NULL)
+    {
+        MPI_Win_unlock_all(tt_win);
+        MPI_Win_free(&tt_win);
+        MPI_Comm_free(&tt_comm);
+    }
+    else
+        topology_free(tt_table, ((size_t)1 << TT_BITS) * sizeof(struct tt_entry));
+    tt_table = NULL;
+}
+
+static inline uint64_t mix(uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+/**
+ * Function to hash a position.
+ *
+ * @param P        side to move
+ * @param O
+ * @param my_move  1 if the side to move is my_colour
+ *
+ * @return key
+ */
+uint64_t tt_hash(uint64_t P, uint64_t O, int my_move)
+{
+    return mix(P ^ mix(O + 0x9e3779b97f4a7c15ULL)) ^ (my_move ? 0 : 0x5851f42d4c957f2dULL);
+}
+
+/**
+ * Function to look a position up.
+ *
+ * @param key
+ * @param depth  plies the caller will search
+ * @param alpha
+ * @param beta
+ * @param score  stored score, set if the entry settles the node
+ * @param move   best move square of the entry, TT_NOMOVE if none
+ *
+ * @return 1 if the caller can return score without searching
+ */
+int tt_probe(uint64_t key, int depth, int alpha, int beta, int *score, int *move)
+{
+    const struct tt_entry *e = &tt_table[key & tt_mask];
+    uint64_t data = e->data;
+
+    *move = TT_NOMOVE;
+    if ((e->lock ^ data) != key)
+    {
+        if (snapshot == NULL)
+            return 0;
+        e = &snapshot[key & (((uint64_t)1 << TT_SNAPBITS) - 1)];
+        data = e->data;
+        if ((e->lock ^ data) != key)
+            return 0;
+    }
+    *move = TT_MOVE(data);
+    if (!tt_cutoffs || TT_DEPTH(data) < depth)
+        return 0;
+
+    int s = TT_SCORE(data), bound = TT_BOUND(data);
+    if (bound == TT_EXACT || (bound == TT_LOWER && s >= beta) || (bound == TT_UPPER && s <= alpha))
+    {
+        *score = s;
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * Function to store a search result. Entries stored earlier in the
+ * same search are only replaced by a search at least as deep.
+ *
+ * @param key
+ * @param depth
+ * @param score
+ * @param bound  TT_EXACT, TT_LOWER or TT_UPPER
+ * @param move   best move square, TT_NOMOVE if none
+ */
+void tt_store(uint64_t key, int depth, int score, int bound, int move)
+{
+    struct tt_entry *e = &tt_table[key & tt_mask];
+    uint64_t old = e->data;
+
+    if (old != 0 && TT_AGE(old) == (tt_generation & 0xff) && TT_DEPTH(old) > depth)
+        return;
+    uint64_t data = (uint64_t)(score + 32768) | (uint64_t)depth << 16 | (uint64_t)bound << 24 |
+                    (uint64_t)move << 26 | (uint64_t)(tt_generation & 0xff) << 33;
+    e->data = data;
+    e->lock = key ^ data;
+}
+
+/*
+    Called by each worker at the start of every search.
+ */
+void tt_new_search()
+{
+    tt_generation++;
+}
+
+/**
+ * Function to map a snapshot read-only, if there is one made with the
+ * same evaluation settings.
+ *
+ * @param path
+ *
+ * @return SUCCESS if it is in use
+ */
+int tt_snapshot_map(const char *path)
+{
+    struct tt_snapshot_header *header;
+    struct stat st;
+    size_t bytes = sizeof(struct tt_snapshot_header) + ((size_t)1 << TT_SNAPBITS) * sizeof(struct tt_entry);
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0)
+        return FAILURE;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size != bytes)
+    {
+        close(fd);
+        return FAILURE;
+    }
+    header = mmap(NULL, bytes, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (header == MAP_FAILED)
+        return FAILURE;
+    if (memcmp(header->magic, TT_SNAPMAGIC, 8) != 0 || header->signature != tt_signature() ||
+        header->entries != (uint64_t)1 << TT_SNAPBITS)
+    {
+        munmap(header, bytes);
+        return FAILURE;
+    }
+    snapshot = (const struct tt_entry *)(header + 1);
+    snapshot_bytes = bytes;
+    return SUCCESS;
+}
+
+/**
+ * Function to write a new snapshot from every rank's table and the old
+ * snapshot. Collective; rank 0 writes the file, to a temporary name
+ * first so a reader never sees half of it.
+ *
+ * @param path
+ *
+ * @return SUCCESS or FAILURE
+ */
+int tt_snapshot_save(const char *path)
+{
+    size_t entries = (size_t)1 << TT_SNAPBITS;
+    size_t bytes = sizeof(struct tt_snapshot_header) + entries * sizeof(struct tt_entry);
+    struct tt_entry *mine = calloc(entries, sizeof(struct tt_entry));
+    struct tt_entry *merged = rank == 0 ? calloc(entries, sizeof(struct tt_entry)) : NULL;
+    MPI_Datatype type;
+    MPI_Op op;
+    int len = entries, result = SUCCESS;
+
+    /* deep entries only, the deepest for each slot */
+    for (size_t i = 0; tt_table != NULL && i <= tt_mask; i++)
+    {
+        struct tt_entry e = tt_table[i];
+        uint64_t key = e.lock ^ e.data;
+        struct tt_entry *slot = &mine[key & (entries - 1)];
+        if (e.data == 0 || TT_DEPTH(e.data) < TT_SNAPDEPTH)
+            continue;
+        if (slot->data == 0 || TT_DEPTH(slot->data) < TT_DEPTH(e.data))
+            *slot = e;
+    }
+
+    MPI_Type_contiguous(2, MPI_UINT64_T, &type);
+    MPI_Type_commit(&type);
+    MPI_Op_create(merge_entries, 1, &op);
+    MPI_Reduce(mine, merged, entries, type, op, 0, MPI_COMM_WORLD);
+    MPI_Op_free(&op);
+    MPI_Type_free(&type);
+    free(mine);
+    if (rank != 0)
+        return SUCCESS;
+
+    /* entries this game did not reach are kept from the old snapshot */
+    if (snapshot != NULL)
+    {
+        merge_entries((void *)snapshot, merged, &len, NULL);
+        munmap((void *)((const struct tt_snapshot_header *)snapshot - 1), snapshot_bytes);
+        snapshot = NULL;
+    }
+
+    char tmp[4096];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    int fd = open(tmp, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    struct tt_snapshot_header *header = MAP_FAILED;
+    if (fd >= 0 && ftruncate(fd, bytes) == 0)
+        header = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (header == MAP_FAILED)
+        result = FAILURE;
+    else
+    {
+        memcpy(header->magic, TT_SNAPMAGIC, 8);
+        header->signature = tt_signature();
+        header->entries = entries;
+        header->reserved = 0;
+        memcpy(header + 1, merged, entries * sizeof(struct tt_entry));
+        if (msync(header, bytes, MS_SYNC) != 0)
+            result = FAILURE;
+        munmap(header, bytes);
+    }
+    if (fd >= 0)
+        close(fd);
+    if (result == SUCCESS && rename(tmp, path) != 0)
+        result = FAILURE;
+    if (result == FAILURE)
+        fprintf(stderr, "tt: cannot write snapshot %s\n", path);
+    free(merged);
+    return result;
+}
+
+/*
+    Reduction: keep the deeper entry of each slot, inout's on a tie.
+ */
+static void merge_entries(void *in, void *inout, int *len, MPI_Datatype *type)
+{
+    const struct tt_entry *a = in;
+    struct tt_entry *b = inout;
+
+    for (int i = 0; i < *len; i++)
+    {
+        if (a[i].data != 0 && (b[i].data == 0 || TT_DEPTH(a[i].data) > TT_DEPTH(b[i].data)))
+            b[i] = a[i];
+    }
+}
+
+/*
+    FNV-1a over everything that changes what a stored score means.
+ */
+uint64_t tt_signature()
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+    int mpc = (int)(mpc_t * 1000);
+    const unsigned char *parts[5] = {(const unsigned char *)weights, (const unsigned char *)&mpc,
+                                     (const unsigned char *)edge_table, (const unsigned char *)corner_table,
+                                     (const unsigned char *)eval_coef};
+    size_t lengths[5] = {sizeof(weights), sizeof(mpc), eval_patterns ? sizeof(edge_table) : 0,
+                         eval_patterns ? sizeof(corner_table) : 0, sizeof(eval_coef)};
+
+    for (int p = 0; p < 5; p++)
+        for (size_t i = 0; i < lengths[p]; i++)
+            h = (h ^ parts[p][i]) * 0x100000001b3ULL;
+    return h;
+}
@@ -0,0 +1,76 @@
+#ifndef _TT_H
+#define _TT_H
+
+#include <stdint.h>
+
+/*
+    Transposition table. An entry is two words, the packed data and the
+    key xor the data, so an entry torn by two writers fails the key check
+    on the next probe instead of returning another position's score.
+    That lets the ranks of one node share a single table (an MPI-3 shared
+    memory window) without locks.
+
+    Scores are from my_colour's view like the rest of minimax(), so the
+    key includes whether my_colour is the side to move. That also makes
+    an entry mean the same in a game played as the other colour.
+
+    The table is kept from move to move, so a position searched two
+    plies ago is found again with the depth left it was searched to.
+    Each search bumps tt_generation; an entry from an earlier search can
+    always be replaced, one from the current search only by a deeper one.
+
+    Snapshot (--snapshot file): at game_over() the entries searched at
+    least TT_SNAPDEPTH deep from every rank are merged, deepest kept,
+    into a table of 2^TT_SNAPBITS entries along with the old snapshot,
+    and written to the file through mmap. At the next start the file is
+    mapped read-only and probed after the live table, so positions the
+    earlier games searched, the openings above all, cost next to nothing.
+    The header holds a signature of the evaluation settings; a snapshot
+    made with other weights is ignored.
+
+    With tt_cutoffs 0 a probe only hands back the stored move: the table
+    still orders moves and keeps the principal variation, but every score
+    is the plain fixed depth value (--multipv without --fast).
+ */
+#define TT_BITS 21
+#define TT_MINDEPTH 2
+#define TT_NOMOVE 64
+#define TT_SNAPBITS 16
+#define TT_SNAPDEPTH 3
+#define TT_SNAPMAGIC "OTHSNAP1"
+
+#define TT_EXACT 0
+#define TT_LOWER 1
+#define TT_UPPER 2
+
+struct tt_entry
+{
+    uint64_t lock; /* key ^ data */
+    uint64_t data;
+};
+
+struct tt_snapshot_header
+{
+    char magic[8];
+    uint64_t signature;
+    uint64_t entries;
+    uint64_t reserved;
+};
+
+extern struct tt_entry *tt_table; /* NULL: no table */
+extern uint64_t tt_mask;
+extern unsigned tt_generation;
+extern int tt_cutoffs;
+
+int tt_init(int shared);
+void tt_clear();
+void tt_free();
+uint64_t tt_hash(uint64_t P, uint64_t O, int my_move);
+int tt_probe(uint64_t key, int depth, int alpha, int beta, int *score, int *move);
+void tt_store(uint64_t key, int depth, int score, int bound, int move);
+void tt_new_search();
+int tt_snapshot_map(const char *path);
+int tt_snapshot_save(const char *path);
+uint64_t tt_signature();
+
+#endif
@@ -0,0 +1,303 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <mpi.h>
+#include "comms.h"
+#include "player.h"
+#include "bitboard.h"
+#include "batch.h"
+#include "evaluate.h"
+#include "tune.h"
+
+#define TUNE_BLOCK 4096
+#define ADAM_BETA1 0.9
+#define ADAM_BETA2 0.999
+#define ADAM_EPSILON 1e-8
+
+static struct tune_sample *samples;
+static long num_samples, max_samples;
+
+static void add_sample(const struct batch_position *pos, int label);
+static long long read_text(const char *path);
+static long long read_binary(const char *path);
+static double predict(const double *params, const struct tune_sample *s);
+
+/**
+ * Entry point for tuning, called on every rank. Rank 0 writes the
+ * fitted tables.
+ *
+ * @param argc
+ * @param argv
+ *
+ * @return SUCCESS or FAILURE
+ */
+int tune_main(int argc, char *argv[])
+{
+    int binary = 0, epochs = TUNE_EPOCHS;
+    double rate = TUNE_RATE;
+    long long total;
+    double *params, *grad, *m, *v;
+    double start = MPI_Wtime();
+
+    for (int i = 4; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--binary") == 0)
+            binary = 1;
+        else if (strcmp(argv[i], "--epochs") == 0 && i + 1 < argc)
+            epochs = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc)
+            rate = atof(argv[++i]);
+    }
+
+    total = binary ? read_binary(argv[2]) : read_text(argv[2]);
+    if (total == 0)
+    {
+        if (rank == 0)
+            fprintf(stderr, "tune: no positions in %s\n", argv[2]);
+        return FAILURE;
+    }
+    if (rank == 0)
+        printf("tune: %lld positions on %d ranks, read in %.2fs\n", total, size, MPI_Wtime() - start);
+
+    /* grad has one extra slot for the squared error */
+    params = calloc(TUNE_PARAMS, sizeof(double));
+    grad = calloc(TUNE_PARAMS + 1, sizeof(double));
+    m = calloc(TUNE_PARAMS, sizeof(double));
+    v = calloc(TUNE_PARAMS, sizeof(double));
+
+    start = MPI_Wtime();
+    for (int epoch = 1; epoch <= epochs; epoch++)
+    {
+        memset(grad, 0, (TUNE_PARAMS + 1) * sizeof(double));
+        for (long i = 0; i < num_samples; i++)
+        {
+            struct tune_sample *s = &samples[i];
+            double err = predict(params, s) - s->label;
+            grad[TUNE_PARAMS] += err * err;
+            double square_err = err * eval_coef[EVAL_MOBILITY];
+            for (uint64_t bits = s->mobility; bits; bits &= bits - 1)
+                grad[TUNE_SQUARES + __builtin_ctzll(bits)] += square_err;
+            for (uint64_t bits = s->opp_mobility; bits; bits &= bits - 1)
+                grad[TUNE_SQUARES + __builtin_ctzll(bits)] -= square_err;
+            for (int k = 0; k < EVAL_INSTANCES; k++)
+            {
+                grad[TUNE_EDGES + s->edge[k]] += err;
+                grad[TUNE_CORNERS + s->corner[k]] += err;
+            }
+        }
+        MPI_Allreduce(MPI_IN_PLACE, grad, TUNE_PARAMS + 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+
+        /* every rank applies the same Adam step */
+        double c1 = 1 - pow(ADAM_BETA1, epoch), c2 = 1 - pow(ADAM_BETA2, epoch);
+        for (int p = 0; p < TUNE_PARAMS; p++)
+        {
+            double g = 2 * grad[p] / total + (p >= TUNE_EDGES ? 2 * TUNE_L2 * params[p] : 0);
+            m[p] = ADAM_BETA1 * m[p] + (1 - ADAM_BETA1) * g;
+            v[p] = ADAM_BETA2 * v[p] + (1 - ADAM_BETA2) * g * g;
+            params[p] -= rate * (m[p] / c1) / (sqrt(v[p] / c2) + ADAM_EPSILON);
+        }
+        if (rank == 0 && (epoch % TUNE_REPORT == 0 || epoch == epochs))
+            printf("epoch %4d rms error %6.3f discs %8.2fs\n", epoch,
+                   sqrt(grad[TUNE_PARAMS] / total) / TUNE_SCALE, MPI_Wtime() - start);
+    }
+
+    int result = SUCCESS;
+    if (rank == 0)
+    {
+        int square_weights[64];
+        for (int sq = 0; sq < 64; sq++)
+            square_weights[sq] = (int)lround(params[TUNE_SQUARES + sq]);
+        for (int i = 0; i < EVAL_EDGESIZE; i++)
+            edge_table[i] = (int16_t)lround(fmax(-32767, fmin(32767, params[TUNE_EDGES + i])));
+        for (int i = 0; i < EVAL_CORNERSIZE; i++)
+            corner_table[i] = (int16_t)lround(fmax(-32767, fmin(32767, params[TUNE_CORNERS + i])));
+        result = evaluate_save(argv[3], square_weights);
+        if (result == FAILURE)
+            fprintf(stderr, "tune: cannot write %s\n", argv[3]);
+    }
+    free(params);
+    free(grad);
+    free(m);
+    free(v);
+    free(samples);
+    return result;
+}
+
+/*
+    evaluate_board() with the parameters being fitted
+ */
+static double predict(const double *params, const struct tune_sample *s)
+{
+    double mobility = 0, score = s->fixed;
+    for (uint64_t bits = s->mobility; bits; bits &= bits - 1)
+        mobility += params[TUNE_SQUARES + __builtin_ctzll(bits)];
+    for (uint64_t bits = s->opp_mobility; bits; bits &= bits - 1)
+        mobility -= params[TUNE_SQUARES + __builtin_ctzll(bits)];
+    for (int k = 0; k < EVAL_INSTANCES; k++)
+        score += params[TUNE_EDGES + s->edge[k]] + params[TUNE_CORNERS + s->corner[k]];
+    return score + eval_coef[EVAL_MOBILITY] * mobility;
+}
+
+/**
+ * Function to turn a position into its features and keep them.
+ *
+ * @param pos
+ * @param label  disc difference from the side to move's view
+ */
+static void add_sample(const struct batch_position *pos, int label)
+{
+    uint64_t P = pos->player == BLACK ? pos->black : pos->white;
+    uint64_t O = pos->player == BLACK ? pos->white : pos->black;
+    int edge[EVAL_INSTANCES], corner[EVAL_INSTANCES];
+    struct tune_sample *s;
+
+    if (num_samples == max_samples)
+    {
+        max_samples = max_samples ? 2 * max_samples : 65536;
+        samples = realloc(samples, max_samples * sizeof(struct tune_sample));
+        if (samples == NULL)
+        {
+            fprintf(stderr, "tune: out of memory at %ld positions\n", num_samples);
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+    s = &samples[num_samples++];
+    s->mobility = bb_moves(P, O);
+    s->opp_mobility = bb_moves(O, P);
+    evaluate_pattern_indices(P, O, edge, corner);
+    for (int k = 0; k < EVAL_INSTANCES; k++)
+    {
+        s->edge[k] = edge[k];
+        s->corner[k] = corner[k];
+    }
+    s->fixed = evaluate_terms(P, O);
+    s->label = label * TUNE_SCALE;
+}
+
+/**
+ * Function to read this rank's share of a text label file: the lines
+ * that start in its contiguous byte range. A rank starting inside a line
+ * skips to the next one, which the rank before it reads.
+ *
+ * @param path
+ *
+ * @return number of positions in the file
+ */
+static long long read_text(const char *path)
+{
+    FILE *in = fopen(path, "r");
+    char text[256];
+    long long count = 0, total;
+    long start, end, offset;
+    struct batch_position pos;
+
+    if (in == NULL)
+    {
+        fprintf(stderr, "tune: cannot open %s\n", path);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    fseek(in, 0, SEEK_END);
+    end = ftell(in);
+    start = end * rank / size;
+    end = end * (rank + 1) / size;
+    fseek(in, start > 0 ? start - 1 : 0, SEEK_SET);
+    if (start > 0)
+    {
+        int c;
+        while ((c = fgetc(in)) != EOF && c != '\n')
+            ;
+    }
+
+    while ((offset = ftell(in)) < end && fgets(text, sizeof(text), in) != NULL)
+    {
+        char *label, *end_label;
+        long value;
+        if (strchr(text, '\n') == NULL && !feof(in))
+        {
+            int c;
+            while ((c = fgetc(in)) != EOF && c != '\n')
+                ;
+            fprintf(stderr, "tune: line at byte %ld is longer than %zu bytes, the rest is ignored\n", offset,
+                    sizeof(text) - 1);
+        }
+        if (text[0] == '#' || text[0] == '\n' || text[0] == '\r')
+            continue;
+        /* the label follows the side to move, which the position check has seen */
+        if (strlen(text) <= 64 || batch_parse_position(text, &pos) == FAILURE)
+        {
+            fprintf(stderr, "tune: bad position at byte %ld\n", offset);
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        label = text + 64;
+        while (*label == ' ' || *label == '\t')
+            label++;
+        value = strtol(label + 1, &end_label, 10);
+        if (end_label == label + 1)
+        {
+            fprintf(stderr, "tune: no label at byte %ld\n", offset);
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        add_sample(&pos, (int)value);
+        count++;
+    }
+    fclose(in);
+    MPI_Allreduce(&count, &total, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+    return total;
+}
+
+/**
+ * Function to read this rank's contiguous share of a binary label file.
+ *
+ * @param path
+ *
+ * @return number of positions in the file
+ */
+static long long read_binary(const char *path)
+{
+    FILE *in = fopen(path, "rb");
+    unsigned char *block;
+    long long total, first, last;
+
+    if (in == NULL)
+    {
+        fprintf(stderr, "tune: cannot open %s\n", path);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    fseek(in, 0, SEEK_END);
+    total = ftell(in) / TUNE_RECORDSIZE;
+    first = total * rank / size;
+    last = total * (rank + 1) / size;
+    fseek(in, first * TUNE_RECORDSIZE, SEEK_SET);
+
+    block = malloc(TUNE_BLOCK * TUNE_RECORDSIZE);
+    while (first < last)
+    {
+        int n = last - first < TUNE_BLOCK ? last - first : TUNE_BLOCK;
+        if (fread(block, TUNE_RECORDSIZE, n, in) != (size_t)n)
+        {
+            fprintf(stderr, "tune: short read in %s\n", path);
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        for (int i = 0; i < n; i++)
+        {
+            unsigned char *rec = block + i * TUNE_RECORDSIZE;
+            struct batch_position pos = {0, 0, rec[16]};
+            for (int j = 7; j >= 0; j--)
+            {
+                pos.black = (pos.black << 8) | rec[j];
+                pos.white = (pos.white << 8) | rec[8 + j];
+            }
+            if ((pos.player != BLACK && pos.player != WHITE) || (pos.black & pos.white))
+            {
+                fprintf(stderr, "tune: bad record %lld\n", first + i + 1);
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+            add_sample(&pos, (signed char)rec[17]);
+        }
+        first += n;
+    }
+    free(block);
+    fclose(in);
+    return total;
+}
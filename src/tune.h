@@ -0,0 +1,50 @@
+#ifndef _TUNE_H
+#define _TUNE_H
+
+#include <stdint.h>
+#include "evaluate.h"
+
+/*
+    Evaluation tuning: fits the square weights and the pattern tables to
+    labelled positions by full batch gradient descent (Adam) on the mean
+    squared error. The model is evaluate_board()'s: the square weights
+    are scaled by the mobility coefficient and the stability and
+    potential mobility terms are held at eval_coef (--eval), so the
+    weights file is only loaded with the same coefficients. Each rank holds a share of the positions, computes its
+    part of the gradient and an MPI_Allreduce sums them, so every rank
+    applies the same update.
+
+    A label is the final disc difference from the side to move's view.
+    Text input is a batch position line followed by the label. Binary
+    input is a sequence of TUNE_RECORDSIZE byte records: a batch record
+    followed by the label as a signed byte. Each rank reads only its own
+    contiguous part of the file, for text the lines starting in its byte
+    range.
+        main --train <labels> <weights.bin> [--binary] [--epochs n] [--rate r] [--eval m,s,f]
+ */
+#define TUNE_RECORDSIZE 18
+#define TUNE_SCALE 8 /* evaluation units per disc */
+#define TUNE_EPOCHS 300
+#define TUNE_RATE 1.0
+#define TUNE_L2 1e-4
+#define TUNE_REPORT 25
+
+#define TUNE_SQUARES 0
+#define TUNE_EDGES 64
+#define TUNE_CORNERS (TUNE_EDGES + EVAL_EDGESIZE)
+#define TUNE_PARAMS (TUNE_CORNERS + EVAL_CORNERSIZE)
+
+/* features of one position, side to move's view */
+struct tune_sample
+{
+    uint64_t mobility;     /* squares the side to move can play */
+    uint64_t opp_mobility; /* squares its opponent can play */
+    uint16_t edge[EVAL_INSTANCES];
+    uint16_t corner[EVAL_INSTANCES];
+    int fixed;             /* the terms held at eval_coef, evaluate_terms() */
+    int16_t label;         /* disc difference * TUNE_SCALE */
+};
+
+int tune_main(int argc, char *argv[]);
+
+#endif